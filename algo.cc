@@ -1,20 +1,27 @@
 #include <iostream>
 #include <vector>
 #include <list>
-#include <unordered_map>
 #include <map>
-#include <unordered_set>
 #include <iterator>
 #include <algorithm>
 #include <utility>
+#include <memory>
+#include <string>
+#include <set>
+#include <functional>
+#include <thread>
+#include <stdexcept>
 
 #include "frac.h"
 #include "pitch.h"
 #include "interval.h"
 #include "tunings.h"
-#include "hash.h"
 #include "algo.h"
 #include "score.h"
+#include "pairs.h"
+#include "solver.h"
+#include "workers.h"
+#include "counters.h"
 
 // Helper function that returns true if dividend divided by divisor
 //   is congruent to other. Congruent in this case means offset by
@@ -34,22 +41,26 @@ bool isQuotientCongruentTo(const Frac& dividend, const Frac& divisor, const Frac
 }
 
 // Returns a list of pairs with first element in fixed and second element in var
-//   representing the pairs to check when optimizing var tunings.
-std::list<std::pair<NoteTuning, EPitch>> findPairsToCheck(const Tuning& fixed, const std::list<EPitch>& var) {
-
-    static int unisonValue = Interval::getWeight(EPitch{Pitch::C, 4}, EPitch{Pitch::C, 4});
-
-    std::unordered_map<EPitch, std::list<NoteTuning>, Hash> varToFixed;
+//   representing the pairs to check when optimizing var tunings, using the
+//   weights of the given interval table. If the best interval between a fixed
+//   and a variable pitch is better than every interval between two variable
+//   pitches (or is a unison), those are the pairs of the lowest variable pitch
+//   with that interval to a fixed pitch, one per such fixed pitch. Otherwise,
+//   they are the pairs of every variable pitch in the best interval between
+//   two variable pitches with every fixed pitch. The pairs are in the order of
+//   var, then of fixed (from its lowest NoteTuning).
+std::list<std::pair<NoteTuning, EPitch>> findPairsToCheck(const Tuning& fixed, const std::vector<EPitch>& var, const Interval& intervals) {
+
+    int unisonValue = intervals.weight(EPitch{Pitch::C, 4}, EPitch{Pitch::C, 4});
+
+    const EPitch* bestVar = nullptr;
     int currBestValue = -1;
     for (const NoteTuning& f : fixed) {
         for (const EPitch& v : var) {
-            int val = Interval::getWeight(f.pitch, v);
-            if (val > currBestValue) {
+            int val = intervals.weight(f.pitch, v);
+            if (val > currBestValue || (val == currBestValue && v < *bestVar)) {
                 currBestValue = val;
-                varToFixed.clear();
-                varToFixed[v].emplace_back(f);
-            } else if (val == currBestValue) {
-                varToFixed[v].emplace_back(f);
+                bestVar = &v;
             }
         }
     }
@@ -57,37 +68,62 @@ std::list<std::pair<NoteTuning, EPitch>> findPairsToCheck(const Tuning& fixed, c
     std::list<std::pair<NoteTuning, EPitch>> bestPairs;
     int currBestValue2 = -1;
     for (const EPitch& v : var) {
+        int best = -1;
         for (const EPitch& w : var) {
-            if (!(w == v)) {
-                int val = Interval::getWeight(v, w);
-                if (val > currBestValue2) {
-                    currBestValue2 = val;
-                    bestPairs.clear();
-                    for (const NoteTuning& f : fixed) {
-                        bestPairs.emplace_back(std::pair<NoteTuning, EPitch>{f, v});
-                    }
-                } else if (val == currBestValue2) {
-                    for (const NoteTuning& f : fixed) {
-                        bestPairs.emplace_back(std::pair<NoteTuning, EPitch>{f, v});
-                    }
-                }
-            }
+            if (!(w == v)) best = std::max(best, intervals.weight(v, w));
+        }
+        if (best < 0 || best < currBestValue2) continue;
+        if (best > currBestValue2) {
+            currBestValue2 = best;
+            bestPairs.clear();
+        }
+        for (const NoteTuning& f : fixed) {
+            bestPairs.emplace_back(std::pair<NoteTuning, EPitch>{f, v});
         }
     }
 
     if (currBestValue > currBestValue2 || currBestValue == unisonValue) {
         bestPairs.clear();
-        auto varToFixedList = *varToFixed.begin();
-        for (const NoteTuning& nt : varToFixedList.second) {
-            bestPairs.emplace_back(std::pair<NoteTuning, EPitch>(nt, varToFixedList.first));
+        for (const NoteTuning& f : fixed) {
+            if (intervals.weight(f.pitch, *bestVar) == currBestValue) {
+                bestPairs.emplace_back(std::pair<NoteTuning, EPitch>(f, *bestVar));
+            }
         }
     }
 
     return bestPairs;
 }
 
-std::map<Tuning, int> Algo::getValuesRec(const Tuning& fixed, std::list<EPitch> var,
-    std::unordered_map<EPitch, std::unordered_set<NoteTuning, Hash>, Hash> calculated) {
+// Returns the ratio that tunes pitch in the ideal ratio of the given interval
+//   table to the given NoteTuning
+Frac ratioFrom(const NoteTuning& rel, const EPitch& pitch, const Interval& intervals) {
+    Frac ratio = intervals.idealRatio(rel.pitch, pitch) * rel.tuning;
+    int octaveOffset = pitch.octave - rel.pitch.octave + (pitch.pitch < rel.pitch.pitch ? -1 : 0);
+    ratio.adjust(octaveOffset);
+    return ratio;
+}
+
+// Removes the pairs whose interval has weight at most threshold, so that they
+//   are not branched on. If every pair is removed, the first one is kept.
+void prunePairs(std::list<std::pair<NoteTuning, EPitch>>& pairs, int threshold, const Interval& intervals) {
+    auto weak = [threshold, &intervals](const std::pair<NoteTuning, EPitch>& pair) {
+        return intervals.weight(pair.first.pitch, pair.second) <= threshold;
+    };
+    std::size_t examined = pairs.size();
+    if (std::all_of(pairs.begin(), pairs.end(), weak)) {
+        if (!pairs.empty()) pairs.erase(std::next(pairs.begin()), pairs.end());
+    } else {
+        pairs.remove_if(weak);
+    }
+    COUNT(pairsPruned, examined - pairs.size());
+}
+
+// Recursive step of valuesRec, where fixed is not empty. The queue holds the
+//   same fixed tuning and variable pitches, and is left unchanged on return.
+//   Unless threshold is negative, the pairs are pruned with it (see
+//   prunePairs).
+std::map<Tuning, int> valuesRec(const Tuning& fixed, std::vector<EPitch> var, PairQueue& queue, const Interval& intervals, int threshold) {
+    COUNT(recursions, 1);
 
     if (var.empty()) {
         std::map<Tuning, int> m{};
@@ -95,48 +131,41 @@ std::map<Tuning, int> Algo::getValuesRec(const Tuning& fixed, std::list<EPitch>
         return m;
     }
 
-    if (fixed.isEmpty()) {
-        EPitch pivot = *(var.begin());
-        var.erase(var.begin());
-        std::map<Tuning, int> m = getValuesRec(Tuning{}.addNoteTuning(NoteTuning{pivot, Frac{1, 1}}), var, calculated);
-        std::map<Tuning, int> mNew{};
-        for (std::pair<Tuning, int> pair : m) {
-            Tuning tuning = pair.first;
-            tuning.addNoteTuning(NoteTuning{pivot, Frac{1, 1}});
-            mNew[tuning] = pair.second;
-        }
-        return mNew;
-    }
-
     std::map<Tuning, int> m{};
-    std::list<std::pair<NoteTuning, EPitch>> fixedVarPairs = findPairsToCheck(fixed, var);
+    std::list<std::pair<NoteTuning, EPitch>> fixedVarPairs = queue.pairs(fixed);
+    COUNT(pairsExamined, fixedVarPairs.size());
+    if (threshold >= 0) prunePairs(fixedVarPairs, threshold, intervals);
     while (!fixedVarPairs.empty()) {
 
         std::pair<NoteTuning, EPitch> pair = *fixedVarPairs.begin();
         EPitch pitch = pair.second;
-        EPitch relPitch = pair.first.pitch;
 
-        std::list<EPitch> varCopy{var};
+        std::vector<EPitch> varCopy{var};
         varCopy.erase(std::find(varCopy.begin(), varCopy.end(), pitch));
 
-        Frac computedRatio = Interval::getIdealRatio(relPitch, pitch) * pair.first.tuning;
-        int octaveOffset = pitch.octave - relPitch.octave + (pitch.pitch < relPitch.pitch ? -1 : 0);
-        computedRatio.adjust(octaveOffset);
+        Frac computedRatio = ratioFrom(pair.first, pitch, intervals);
 
-        calculated[pitch].emplace(pair.first);
-        std::map<Tuning, int> mSub = getValuesRec(fixed + NoteTuning{pitch, computedRatio}, varCopy, calculated);
+        queue.fix(NoteTuning{pitch, computedRatio});
+        std::map<Tuning, int> mSub = valuesRec(fixed + NoteTuning{pitch, computedRatio}, varCopy, queue, intervals, threshold);
+        queue.unfix();
 
+		// The pairs tuned in their ideal ratio by this branch are removed, so
+		//   that they are not branched on again; one of them is the pair
+		//   branched on, and the others are pruned
         int valueToAdd = 0;
+        std::size_t remaining = fixedVarPairs.size();
         for (NoteTuning nt :fixed) {
-            Frac ideal = Interval::getIdealRatio(nt.pitch, pitch);
+            Frac ideal = intervals.idealRatio(nt.pitch, pitch);
             if (isQuotientCongruentTo(computedRatio, nt.tuning, ideal)) {
-                valueToAdd += Interval::getWeight(nt.pitch, pitch);
+                valueToAdd += intervals.weight(nt.pitch, pitch);
                 fixedVarPairs.remove(std::pair<NoteTuning, EPitch>{nt, pitch});
             } else if (isQuotientCongruentTo(nt.tuning, computedRatio, ideal)) {
-                valueToAdd += Interval::getWeight(nt.pitch, pitch);
+                valueToAdd += intervals.weight(nt.pitch, pitch);
             }
         }
 
+        COUNT(pairsPruned, remaining - fixedVarPairs.size() - 1);
+        COUNT(tunings, mSub.size());
         for (std::pair<Tuning, int> pair : mSub) {
             Tuning tuning = pair.first;
             tuning.addNoteTuning(NoteTuning{pitch, computedRatio});
@@ -147,8 +176,327 @@ std::map<Tuning, int> Algo::getValuesRec(const Tuning& fixed, std::list<EPitch>
     return m;
 }
 
-std::multimap<int, Tuning> Algo::getValues(const Tuning& fixed, const std::list<EPitch>& var) {
-    std::map<Tuning, int> m = getValuesRec(fixed, var);
+// Implementation of getValuesRec with the given interval table, which the
+//   callers look up once per search rather than on every pair. The variable
+//   pitches are copied at every level of the recursion, so they are kept in a
+//   vector rather than a list. See the recursive step for threshold, which is
+//   -1 for an exact search.
+std::map<Tuning, int> valuesRec(const Tuning& fixed, std::vector<EPitch> var, const Interval& intervals, int threshold) {
+
+    if (var.empty()) {
+        std::map<Tuning, int> m{};
+        m[Tuning{}] = 0;
+        return m;
+    }
+
+    if (fixed.isEmpty()) {
+        EPitch pivot = *(var.begin());
+        var.erase(var.begin());
+        std::map<Tuning, int> m = valuesRec(Tuning{}.addNoteTuning(NoteTuning{pivot, Frac{1, 1}}), var, intervals, threshold);
+        std::map<Tuning, int> mNew{};
+        for (std::pair<Tuning, int> pair : m) {
+            Tuning tuning = pair.first;
+            tuning.addNoteTuning(NoteTuning{pivot, Frac{1, 1}});
+            mNew[tuning] = pair.second;
+        }
+        return mNew;
+    }
+
+    PairQueue queue{fixed, var, intervals};
+    return valuesRec(fixed, var, queue, intervals, threshold);
+}
+
+// Implementation of the Greedy tier: the variable pitches are tuned one at a
+//   time through the best pair between a tuned pitch and a pitch that is not
+//   tuned yet (see PairQueue::bestPair), without branching, so the map has a
+//   single tuning
+std::map<Tuning, int> greedyValues(const Tuning& fixed, std::vector<EPitch> var, const Interval& intervals) {
+    Tuning tuning{};
+    Tuning tuned{fixed};
+    if (fixed.isEmpty() && !var.empty()) {
+        tuning.addNoteTuning(NoteTuning{var.front(), Frac{1, 1}});
+        tuned = tuning;
+        var.erase(var.begin());
+    }
+
+    PairQueue queue{tuned, var, intervals};
+    for (unsigned int i = 0; i < var.size(); i++) {
+        std::pair<NoteTuning, EPitch> pair = queue.bestPair();
+        NoteTuning nt{pair.second, ratioFrom(pair.first, pair.second, intervals)};
+        queue.fix(nt);
+        tuning.addNoteTuning(nt);
+    }
+
+    std::map<Tuning, int> m{};
+    m[tuning] = Algo::evaluate(fixed, tuning, intervals);
+    return m;
+}
+
+std::map<Tuning, int> Algo::getValuesRec(const Tuning& fixed, const std::list<EPitch>& var) {
+    return valuesRec(fixed, std::vector<EPitch>{var.begin(), var.end()}, Interval::standard(), -1);
+}
+
+std::map<Tuning, int> Algo::getValuesRec(const Tuning& fixed, const PitchSpan& var) {
+    return valuesRec(fixed, std::vector<EPitch>{var.begin(), var.end()}, Interval::standard(), -1);
+}
+
+// Returns the weight of the interval between the two NoteTunings in the given
+//   interval table if they are tuned in its ideal ratio, and 0 otherwise. This
+//   is the amount that getValuesRec adds to the value of a tuning for every
+//   pair of pitches in it.
+int pairValue(const NoteTuning& a, const NoteTuning& b, const Interval& intervals) {
+    Frac ideal = intervals.idealRatio(a.pitch, b.pitch);
+    if (isQuotientCongruentTo(b.tuning, a.tuning, ideal) || isQuotientCongruentTo(a.tuning, b.tuning, ideal)) {
+        return intervals.weight(a.pitch, b.pitch);
+    }
+    return 0;
+}
+
+int Algo::evaluate(const Tuning& fixed, const Tuning& tuning) {
+    return evaluate(fixed, tuning, Interval::standard());
+}
+
+int Algo::evaluate(const Tuning& fixed, const Tuning& tuning, const Interval& intervals) {
+    int value = 0;
+    for (auto it = tuning.begin(); it != tuning.end(); ++it) {
+        NoteTuning nt = *it;
+        for (const NoteTuning& f : fixed) {
+            value += pairValue(f, nt, intervals);
+        }
+        auto other = it;
+        for (++other; other != tuning.end(); ++other) {
+            value += pairValue(nt, *other, intervals);
+        }
+    }
+    return value;
+}
+
+// Returns the connected components of the graph over var in which two pitches
+//   are adjacent if the interval between them has weight larger than threshold
+std::vector<std::vector<EPitch>> findComponents(const std::vector<EPitch>& pitches, int threshold) {
+    const Interval& intervals = Interval::standard();
+    std::vector<int> component(pitches.size(), -1);
+    int n = 0;
+    for (unsigned int i = 0; i < pitches.size(); i++) {
+        if (component[i] >= 0) continue;
+        std::vector<unsigned int> stack{i};
+        component[i] = n;
+        while (!stack.empty()) {
+            unsigned int at = stack.back();
+            stack.pop_back();
+            for (unsigned int j = 0; j < pitches.size(); j++) {
+                if (component[j] < 0 && (intervals.weight(pitches[at], pitches[j]) > threshold
+                                      || intervals.weight(pitches[j], pitches[at]) > threshold)) {
+                    component[j] = n;
+                    stack.emplace_back(j);
+                }
+            }
+        }
+        n++;
+    }
+
+    std::vector<std::vector<EPitch>> components(n);
+    for (unsigned int i = 0; i < pitches.size(); i++) {
+        components[component[i]].emplace_back(pitches[i]);
+    }
+    return components;
+}
+
+// Returns the scales of other that maximize the value of the intervals between
+//   joined and other scaled by them, among the scales that tune some interval
+//   between them in its ideal ratio, and sets value to that value
+std::vector<Frac> bestScales(const Tuning& joined, const Tuning& other, const Interval& intervals, int& value) {
+    std::set<Frac> scales;
+    for (const NoteTuning& a : joined) {
+        for (const NoteTuning& b : other) {
+            scales.insert(ratioFrom(a, b.pitch, intervals) / b.tuning);
+        }
+    }
+    std::vector<Frac> best;
+    value = -1;
+    for (const Frac& s : scales) {
+        int v = 0;
+        for (const NoteTuning& b : other) {
+            NoteTuning scaled{b.pitch, b.tuning * s};
+            for (const NoteTuning& a : joined) v += pairValue(a, scaled, intervals);
+        }
+        if (v > value) {
+            value = v;
+            best.clear();
+        }
+        if (v == value) best.emplace_back(s);
+    }
+    return best;
+}
+
+// Returns the shared threads that large components are solved on
+Workers& componentWorkers() {
+    static Workers workers{std::thread::hardware_concurrency()};
+    return workers;
+}
+
+// Implementation of getValuesDecomposed, where every component is searched
+//   with the given threshold (see valuesRec). Returns false, leaving m empty,
+//   if var has a single component, or if Exact mode could not prove its result.
+bool decomposedValues(const Tuning& fixed, std::vector<EPitch> var, Algo::Decomposition mode, int threshold, int search, std::map<Tuning, int>& m) {
+	// In Exact mode, a chord with no fixed pitches is solved against its first
+	//   pitch, as getValuesRec does, so that its components are tuned relative
+	//   to that pitch instead of aligned to each other
+    if (mode == Algo::Decomposition::Exact && fixed.isEmpty() && !var.empty()) {
+        NoteTuning pivot{var.front(), Frac{1, 1}};
+        var.erase(var.begin());
+        std::map<Tuning, int> sub;
+        if (!decomposedValues(Tuning{}.addNoteTuning(pivot), var, mode, threshold, search, sub)) return false;
+        for (auto& pair : sub) {
+            Tuning tuning = pair.first;
+            tuning.addNoteTuning(pivot);
+            m[tuning] = pair.second;
+        }
+        return true;
+    }
+
+    std::vector<std::vector<EPitch>> components = findComponents(var, threshold);
+    if (components.size() < 2) return false;
+    const Interval& intervals = Interval::standard();
+
+	// Exact mode only succeeds if every interval between components is tuned
+	//   in its ideal ratio, so it first checks that the Greedy tunings of the
+	//   components do that, which costs little next to searching them. If they
+	//   do not, the chord is left to getValuesRec. This only decides whether
+	//   to try, so it does not affect the result.
+    if (mode == Algo::Decomposition::Exact) {
+        Tuning greedy{};
+        for (const std::vector<EPitch>& c : components) {
+            Tuning tuning = greedyValues(fixed, c, intervals).begin()->first;
+            for (const NoteTuning& b : tuning) {
+                for (const NoteTuning& a : greedy) {
+                    if (pairValue(a, b, intervals) == 0) {
+                        COUNT(decompositionFallbacks, 1);
+                        return false;
+                    }
+                }
+            }
+            for (const NoteTuning& b : tuning) greedy.addNoteTuning(b);
+        }
+    }
+
+	// The components are joined from the smallest, so that Exact mode can
+	//   give up before it searches the largest ones
+    std::stable_sort(components.begin(), components.end(), [](const std::vector<EPitch>& a, const std::vector<EPitch>& b) {
+        return a.size() < b.size();
+    });
+
+	// In Fast mode, the components are searched up front, on the calling
+	//   thread unless one of them is large enough for its search to outweigh
+	//   handing it to another thread. In Exact mode, they are searched one at
+	//   a time as they are joined.
+    std::vector<std::map<Tuning, int>> solved(components.size());
+    std::function<void(unsigned int)> solve = [&](unsigned int i) {
+        solved[i] = valuesRec(fixed, components[i], intervals, search);
+    };
+    if (mode == Algo::Decomposition::Fast) {
+        if (components.back().size() >= Algo::parallelPitches) componentWorkers().forEach(components.size(), solve);
+        else for (unsigned int i = 0; i < components.size(); i++) solve(i);
+    }
+
+	// Every partial join is extended by the best tunings of the next
+	//   component. If there are no fixed pitches, they are aligned to the
+	//   partial join by every scale that maximizes the value of the intervals
+	//   between them.
+	// No tuning of the chord can do better on a component than the best
+	//   tunings of that component, or better on an interval between
+	//   components than its weight, so the sum of those over the components
+	//   joined so far is a bound on the value of their pitches. In Exact mode,
+	//   the partial join must reach it, tuning every interval between the
+	//   components in its ideal ratio; the best tunings of the chord are
+	//   then those that reach the bound once every component is joined.
+    std::vector<std::pair<Tuning, int>> joined{std::pair<Tuning, int>{Tuning{}, 0}};
+    int bound = 0;
+    for (unsigned int i = 0; i < components.size(); i++) {
+        if (mode == Algo::Decomposition::Exact) solve(i);
+        int bestValue = -1;
+        for (auto& pair : solved[i]) bestValue = std::max(bestValue, pair.second);
+        bound += bestValue;
+        for (unsigned int j = 0; j < i; j++) {
+            for (const EPitch& a : components[j]) {
+                for (const EPitch& b : components[i]) bound += intervals.weight(a, b);
+            }
+        }
+
+        std::vector<std::pair<Tuning, int>> next;
+        int reached = -1;
+        for (const std::pair<Tuning, int>& partial : joined) {
+            for (const std::pair<const Tuning, int>& candidate : solved[i]) {
+                if (candidate.second != bestValue) continue;
+                int value = 0;
+                std::vector<Frac> scales{Frac{1, 1}};
+                if (fixed.isEmpty() && i > 0) {
+                    scales = bestScales(partial.first, candidate.first, intervals, value);
+                } else {
+                    for (const NoteTuning& b : candidate.first) {
+                        for (const NoteTuning& a : partial.first) value += pairValue(a, b, intervals);
+                    }
+                }
+                for (const Frac& scale : scales) {
+                    Tuning tuning = partial.first;
+                    for (const NoteTuning& b : candidate.first) tuning.addNoteTuning(NoteTuning{b.pitch, b.tuning * scale});
+                    next.emplace_back(std::move(tuning), partial.second + candidate.second + value);
+                    reached = std::max(reached, next.back().second);
+                }
+            }
+        }
+        joined = std::move(next);
+
+        if (mode == Algo::Decomposition::Exact) {
+            if (reached < bound) {
+                COUNT(decompositionFallbacks, 1);
+                return false;
+            }
+            joined.erase(std::remove_if(joined.begin(), joined.end(), [bound](const std::pair<Tuning, int>& pair) {
+                return pair.second < bound;
+            }), joined.end());
+        }
+    }
+
+    COUNT(decompositions, 1);
+    for (auto& pair : joined) {
+        auto find = m.find(pair.first);
+        if (find == m.end() || find->second < pair.second) m[pair.first] = pair.second;
+    }
+    return true;
+}
+
+std::map<Tuning, int> Algo::getValuesDecomposed(const Tuning& fixed, const std::list<EPitch>& var, Decomposition mode, int threshold, bool* joined) {
+    std::vector<EPitch> pitches{var.begin(), var.end()};
+    std::map<Tuning, int> m;
+    bool decomposed = decomposedValues(fixed, pitches, mode, threshold, -1, m);
+    if (joined) *joined = decomposed;
+    return decomposed ? m : valuesRec(fixed, pitches, Interval::standard(), -1);
+}
+
+// Returns the tunings of var against fixed found by the tier of the given
+//   options
+std::map<Tuning, int> valuesWith(const Tuning& fixed, std::vector<EPitch> var, const Algo::Options& options) {
+    if (options.decompose && options.tier != Algo::Tier::Greedy) {
+        std::map<Tuning, int> m;
+        Algo::Decomposition mode = options.tier == Algo::Tier::Exact ? Algo::Decomposition::Exact : Algo::Decomposition::Fast;
+        int search = options.tier == Algo::Tier::Exact ? -1 : options.threshold;
+        if (decomposedValues(fixed, var, mode, options.threshold, search, m)) return m;
+    }
+    const Interval& intervals = Interval::standard();
+    switch (options.tier) {
+        case Algo::Tier::Pruned: return valuesRec(fixed, var, intervals, options.threshold);
+        case Algo::Tier::Greedy: return greedyValues(fixed, var, intervals);
+        default: return valuesRec(fixed, var, intervals, -1);
+    }
+}
+
+std::map<Tuning, int> Algo::getValuesRec(const Tuning& fixed, const PitchSpan& var, const Options& options) {
+    return valuesWith(fixed, std::vector<EPitch>{var.begin(), var.end()}, options);
+}
+
+// Returns the values computed by getValuesRec, keyed by value
+std::multimap<int, Tuning> byValue(const std::map<Tuning, int>& m) {
     std::multimap<int, Tuning> mm{};
     for (auto pair : m) {
         mm.insert(std::pair<int, Tuning>{pair.second, pair.first});
@@ -156,8 +504,8 @@ std::multimap<int, Tuning> Algo::getValues(const Tuning& fixed, const std::list<
     return mm;
 }
 
-std::vector<Tuning> Algo::getBestValues(const Tuning& fixed, const std::list<EPitch>& var) {
-    std::multimap<int, Tuning> mm = getValues(fixed, var);
+// Returns the tunings of mm with the best value
+std::vector<Tuning> bestOf(const std::multimap<int, Tuning>& mm) {
     std::vector<Tuning> v;
     if (mm.empty()) return v;
     auto rit = mm.rbegin();
@@ -169,124 +517,289 @@ std::vector<Tuning> Algo::getBestValues(const Tuning& fixed, const std::list<EPi
     return v;
 }
 
-std::vector<TuningSequence> Algo::getTuningsRec(std::multimap<int, Tuning> prev, std::list<std::list<EPitch>> next, int& value, unsigned int trim) {
+std::multimap<int, Tuning> Algo::getValues(const Tuning& fixed, const std::list<EPitch>& var) {
+    return byValue(getValuesRec(fixed, var));
+}
+
+std::multimap<int, Tuning> Algo::getValues(const Tuning& fixed, const PitchSpan& var) {
+    return byValue(getValuesRec(fixed, var));
+}
+
+std::vector<Tuning> Algo::getBestValues(const Tuning& fixed, const std::list<EPitch>& var) {
+    return bestOf(getValues(fixed, var));
+}
+
+std::vector<Tuning> Algo::getBestValues(const Tuning& fixed, const PitchSpan& var) {
+    return bestOf(getValues(fixed, var));
+}
 
-    if (next.empty()) {
-        std::vector<TuningSequence> v;
-        auto rit = prev.rbegin();
-        int bestValue = (*rit).first;
-        while ((rit != prev.rend()) && (*rit).first == bestValue) {
-            TuningSequence ts;
-            ts.addTuning((*rit).second);
-            v.emplace_back(ts);
-            ++rit;
+std::vector<Tuning> Algo::getBestValues(const Tuning& fixed, const std::list<EPitch>& var, const Options& options) {
+    return bestOf(byValue(valuesWith(fixed, std::vector<EPitch>{var.begin(), var.end()}, options)));
+}
+
+std::vector<Tuning> Algo::getBestValues(const Tuning& fixed, const PitchSpan& var, const Options& options) {
+    return bestOf(byValue(valuesWith(fixed, std::vector<EPitch>{var.begin(), var.end()}, options)));
+}
+
+// Implementation of getValuesMulti, with the variable pitches kept in a vector
+//   (see valuesRec)
+std::map<Tuning, std::vector<int>> valuesMulti(const Tuning& fixed, std::vector<EPitch> var, const std::vector<Interval>& profiles, unsigned long active) {
+
+    if (var.empty()) {
+        std::map<Tuning, std::vector<int>> m{};
+        std::vector<int> values(profiles.size(), -1);
+        for (unsigned int i = 0; i < profiles.size(); i++) {
+            if (active & (1ul << i)) values[i] = 0;
         }
-        value = bestValue;
-        return v;
+        m[Tuning{}] = values;
+        return m;
     }
 
-    if ((trim > 0) && (prev.size() > trim)) {
-        std::multimap<int, Tuning> prevCopy;
-        unsigned int i = 0;
-        for (auto it = prev.rbegin(); i < trim; ++it) {
-            prevCopy.insert(*it);
-            i++;
-        }
-        prev = std::move(prevCopy);
-    }
-
-    std::map<Tuning, std::pair<std::set<Tuning>, int>> backMap;
-    for (auto& prevTuning : prev) {
-        std::multimap<int, Tuning> nextTunings = getValues(prevTuning.second, *(next.begin()));
-        for (auto& nextTuning : nextTunings) {
-            int val = nextTuning.first;
-            Tuning tuning = nextTuning.second;
-            try {
-                if (prevTuning.first + val > backMap.at(tuning).second) {
-                    backMap[tuning] = std::pair<std::set<Tuning>, int>{std::set<Tuning>{prevTuning.second}, prevTuning.first + val};
-                } else if (prevTuning.first + val == backMap.at(tuning).second) {
-                    backMap[tuning].first.insert(prevTuning.second);
-                }
-            } catch (std::out_of_range& e) {
-                backMap[tuning] = std::pair<std::set<Tuning>, int>{std::set<Tuning>{prevTuning.second}, prevTuning.first + val};
-            }
+	// Once a single profile is left, the rest of the search is that of
+	//   getValuesRec with its table, which finds the pairs to check
+	//   incrementally and keeps a single value per tuning
+    if (active && !(active & (active - 1))) {
+        unsigned int i = __builtin_ctzl(active);
+        std::map<Tuning, std::vector<int>> m{};
+        for (auto& pair : valuesRec(fixed, var, profiles[i], -1)) {
+            std::vector<int> values(profiles.size(), -1);
+            values[i] = pair.second;
+            m.emplace_hint(m.end(), pair.first, std::move(values));
         }
+        return m;
     }
 
-    std::multimap<int, Tuning> nextPrev;
-    for (auto& pair : backMap) {
-        nextPrev.insert(std::pair<int, Tuning>{pair.second.second, pair.first});
+    if (fixed.isEmpty()) {
+        EPitch pivot = *(var.begin());
+        var.erase(var.begin());
+        std::map<Tuning, std::vector<int>> m = valuesMulti(Tuning{}.addNoteTuning(NoteTuning{pivot, Frac{1, 1}}), var, profiles, active);
+        std::map<Tuning, std::vector<int>> mNew{};
+        for (auto& pair : m) {
+            Tuning tuning = pair.first;
+            tuning.addNoteTuning(NoteTuning{pivot, Frac{1, 1}});
+            mNew[tuning] = pair.second;
+        }
+        return mNew;
     }
-    next.erase(next.begin());
-    std::vector<TuningSequence> bestNextTunings = getTuningsRec(nextPrev, next, value, trim);
 
-    std::vector<TuningSequence> v;
-    for (TuningSequence& ts : bestNextTunings) {
-        std::set<Tuning> backMapped = backMap[*(ts.begin())].first;
-        for (auto& prevTuning : backMapped) {
-            v.emplace_back(prevTuning + ts);
+	// Every pair that an active profile would check, along with the ideal
+	//   ratio of that profile and the set of profiles that check it with
+	//   that ratio
+    struct Branch {
+        NoteTuning rel;
+        EPitch pitch;
+        Frac ratio;
+        unsigned long profiles;
+    };
+    std::list<Branch> branches;
+    std::vector<std::list<std::pair<NoteTuning, EPitch>>> pairsToCheck(profiles.size());
+    for (unsigned int i = 0; i < profiles.size(); i++) {
+        if (!(active & (1ul << i))) continue;
+		// The pairs to check only depend on the weights, so they are shared
+		//   with an earlier profile that has the same weights
+        unsigned int j = 0;
+        while (j < i && (!(active & (1ul << j)) || !profiles[j].sameWeights(profiles[i]))) j++;
+        if (j == i) pairsToCheck[i] = findPairsToCheck(fixed, var, profiles[i]);
+        for (auto& pair : pairsToCheck[j]) {
+            Frac ratio = profiles[i].idealRatio(pair.first.pitch, pair.second);
+            auto same = std::find_if(branches.begin(), branches.end(), [&](const Branch& b) {
+                return b.rel == pair.first && b.pitch == pair.second && b.ratio == ratio;
+            });
+            if (same == branches.end()) branches.emplace_back(Branch{pair.first, pair.second, ratio, 1ul << i});
+            else same->profiles |= 1ul << i;
         }
     }
 
-    return v;
-}
+    std::map<Tuning, std::vector<int>> m{};
+    while (!branches.empty()) {
 
-std::vector<TuningSequence> Algo::getTunings(std::list<std::list<EPitch>> seq, int* val) {
+        Branch branch = *branches.begin();
+        EPitch pitch = branch.pitch;
+        EPitch relPitch = branch.rel.pitch;
 
-    int s = seq.size();
+        std::vector<EPitch> varCopy{var};
+        varCopy.erase(std::find(varCopy.begin(), varCopy.end(), pitch));
 
-    if (s == 0) return std::vector<TuningSequence>{};
+        Frac computedRatio = branch.ratio * branch.rel.tuning;
+        int octaveOffset = pitch.octave - relPitch.octave + (pitch.pitch < relPitch.pitch ? -1 : 0);
+        computedRatio.adjust(octaveOffset);
 
-    if (s == 1) {
-        std::vector<Tuning> bestTunings = getBestValues(Tuning{}, *(seq.begin()));
-        std::vector<TuningSequence> v;
-        for (Tuning& tuning : bestTunings) {
-            v.emplace_back(TuningSequence{}.addTuning(tuning));
+		// Every branch that would tune the pitch the same way is explored
+		//   now, for all of the profiles that check it
+        unsigned long subActive = 0;
+        branches.remove_if([&](const Branch& b) {
+            if (b.pitch == pitch && isQuotientCongruentTo(computedRatio, b.rel.tuning, b.ratio)) {
+                subActive |= b.profiles;
+                return true;
+            }
+            return false;
+        });
+
+        std::map<Tuning, std::vector<int>> mSub = valuesMulti(fixed + NoteTuning{pitch, computedRatio}, varCopy, profiles, subActive);
+
+        std::vector<int> valueToAdd(profiles.size(), 0);
+        for (NoteTuning nt : fixed) {
+			// Profiles that share an ideal ratio for this interval share the
+			//   congruence test
+            std::vector<std::pair<Frac, bool>> tested;
+            for (unsigned int i = 0; i < profiles.size(); i++) {
+                if (!(subActive & (1ul << i))) continue;
+                Frac ideal = profiles[i].idealRatio(nt.pitch, pitch);
+                auto find = std::find_if(tested.begin(), tested.end(), [&ideal](const std::pair<Frac, bool>& t) {
+                    return t.first == ideal;
+                });
+                if (find == tested.end()) {
+                    bool congruent = isQuotientCongruentTo(computedRatio, nt.tuning, ideal) || isQuotientCongruentTo(nt.tuning, computedRatio, ideal);
+                    find = tested.emplace(tested.end(), ideal, congruent);
+                }
+                if (find->second) valueToAdd[i] += profiles[i].weight(nt.pitch, pitch);
+            }
         }
-        return v;
-    }
 
-    if (s == 2) {
-        std::vector<TuningSequence> v;
-        std::list<EPitch> secondNotes{*std::next(seq.begin())};
-        (*seq.begin()).splice((*seq.begin()).end(), *std::next(seq.begin()));
-        std::vector<Tuning> bestTunings = getBestValues(Tuning{}, *seq.begin());
-        for (Tuning& tuning : bestTunings) {
-            Tuning second = tuning.split(secondNotes);
-            v.emplace_back(TuningSequence{}.addTuning(tuning).addTuning(second));
+        for (auto& pair : mSub) {
+            Tuning tuning = pair.first;
+            tuning.addNoteTuning(NoteTuning{pitch, computedRatio});
+			// The same tuning can be reached through branches explored for
+			//   different profiles, so values are merged per profile
+            auto find = m.emplace(tuning, std::vector<int>(profiles.size(), -1)).first;
+            for (unsigned int i = 0; i < profiles.size(); i++) {
+                if (pair.second[i] >= 0) find->second[i] = pair.second[i] + valueToAdd[i];
+            }
         }
-        return v;
     }
 
-    std::list<EPitch> secondNotes{*std::next(seq.begin())};
-    (*seq.begin()).splice((*seq.begin()).end(), *std::next(seq.begin()));
+    return m;
+}
+
+// Throws std::invalid_argument unless there are between 1 and maxProfiles
+//   profiles
+void checkProfiles(const std::vector<Interval>& profiles) {
+    if (profiles.empty() || profiles.size() > Algo::maxProfiles) {
+        throw std::invalid_argument("expected 1 to " + std::to_string(Algo::maxProfiles) + " profiles, got " + std::to_string(profiles.size()));
+    }
+}
+
+std::map<Tuning, std::vector<int>> Algo::getValuesMulti(const Tuning& fixed, const std::list<EPitch>& var, const std::vector<Interval>& profiles, unsigned long active) {
+    checkProfiles(profiles);
+    return valuesMulti(fixed, std::vector<EPitch>{var.begin(), var.end()}, profiles, active);
+}
+
+std::map<Tuning, std::vector<int>> Algo::getValuesMulti(const Tuning& fixed, const PitchSpan& var, const std::vector<Interval>& profiles, unsigned long active) {
+    checkProfiles(profiles);
+    return valuesMulti(fixed, std::vector<EPitch>{var.begin(), var.end()}, profiles, active);
+}
 
-    std::multimap<int, Tuning> startTunings = getValues(Tuning{}, *seq.begin());
-    std::vector<TuningSequence> v;
+// Returns the tunings of m with the best value in the column of the given
+//   profile, in the same order that getBestValues would return them
+std::vector<Tuning> bestOf(const std::map<Tuning, std::vector<int>>& m, unsigned int profile) {
+    std::vector<Tuning> v;
     int bestValue = -1;
+    for (auto& pair : m) bestValue = std::max(bestValue, pair.second[profile]);
+    for (auto rit = m.rbegin(); rit != m.rend(); ++rit) {
+        if (rit->second[profile] == bestValue) v.emplace_back(rit->first);
+    }
+    return v;
+}
 
-    for (auto& pair : startTunings) {
-        Tuning& first = pair.second;
-        Tuning second = first.split(secondNotes);
-        int value = -1;
-        std::multimap<int, Tuning> next;
-        next.insert(std::pair<int, Tuning>{pair.first, second});
+// Returns the tunings of m with the best value for every profile
+std::vector<std::vector<Tuning>> bestOfEach(const std::map<Tuning, std::vector<int>>& m, unsigned int profiles) {
+    std::vector<std::vector<Tuning>> v;
+    for (unsigned int i = 0; i < profiles; i++) {
+        v.emplace_back(bestOf(m, i));
+    }
+    return v;
+}
 
-        std::vector<TuningSequence> bestTunings = getTuningsRec(next, std::list<std::list<EPitch>>{std::next(seq.begin(), 2), seq.end()}, value, 8);
+std::vector<std::vector<Tuning>> Algo::getBestValues(const Tuning& fixed, const std::list<EPitch>& var, const std::vector<Interval>& profiles) {
+    return bestOfEach(getValuesMulti(fixed, var, profiles), profiles.size());
+}
 
-        if (value > bestValue) {
-            bestValue = value;
-            v.clear();
-            for (TuningSequence& bestTuning : bestTunings) {
-                v.emplace_back(first + bestTuning);
-            }
-        } else if (value == bestValue) {
-            for (TuningSequence& bestTuning : bestTunings) {
-                v.emplace_back(first + bestTuning);
-            }
+std::vector<std::vector<Tuning>> Algo::getBestValues(const Tuning& fixed, const PitchSpan& var, const std::vector<Interval>& profiles) {
+    return bestOfEach(getValuesMulti(fixed, var, profiles), profiles.size());
+}
+
+unsigned long Algo::fingerprint(const ChordSequence& seq, unsigned int trim, const Options& options) {
+    unsigned long h = 14695981039346656037ul;
+    auto mix = [&h](unsigned long n) {
+        h = (h ^ n) * 1099511628211ul;
+    };
+    mix(trim);
+    for (unsigned int i = 0; i < seq.size(); i++) {
+        mix(seq[i].size());
+        for (const EPitch& pitch : seq[i]) {
+            mix(12 * pitch.octave + static_cast<int>(pitch.pitch));
         }
     }
+    if (seq.counts) {
+        for (unsigned int i = 0; i < seq.size(); i++) mix(seq.count(i));
+    }
+	// Exact solves are left as they were, so that their checkpoints stay valid
+    if (options.tier != Tier::Exact || options.decompose) {
+        mix(static_cast<unsigned long>(options.tier));
+        mix(options.threshold);
+    }
+    if (options.decompose) mix(1);
+    return h;
+}
 
-    if (val) *val = bestValue;
-    return v;
+bool Algo::sameSearch(const Options& a, const Options& b) {
+    return a.tier == b.tier && a.threshold == b.threshold && a.decompose == b.decompose;
+}
+
+// Flattens a list of chords into the arrays of a ChordSequence
+void flatten(const std::list<std::list<EPitch>>& seq, std::vector<EPitch>& pitches, std::vector<unsigned int>& offsets) {
+    offsets.emplace_back(0);
+    for (const std::list<EPitch>& chord : seq) {
+        pitches.insert(pitches.end(), chord.begin(), chord.end());
+        offsets.emplace_back(pitches.size());
+    }
+}
+
+std::vector<TuningSequence> Algo::getTunings(std::list<std::list<EPitch>> seq, int* val) {
+    return getTunings(seq, "", 0, val);
+}
+
+std::vector<TuningSequence> Algo::getTunings(std::list<std::list<EPitch>> seq, const std::string& file, unsigned int interval, int* val) {
+    std::vector<EPitch> pitches;
+    std::vector<unsigned int> offsets;
+    flatten(seq, pitches, offsets);
+    return getTunings(ChordSequence{pitches.data(), offsets.data(), static_cast<unsigned int>(seq.size())}, file, interval, val);
+}
+
+std::vector<TuningSequence> Algo::getTunings(std::list<std::list<EPitch>> seq, const Options& options, int* val) {
+    std::vector<EPitch> pitches;
+    std::vector<unsigned int> offsets;
+    flatten(seq, pitches, offsets);
+    return getTunings(ChordSequence{pitches.data(), offsets.data(), static_cast<unsigned int>(seq.size())}, "", 0, options, val);
+}
+
+std::vector<TuningSequence> Algo::getTunings(const ChordSequence& seq, int* val) {
+    return getTunings(seq, "", 0, Options{}, val);
+}
+
+std::vector<TuningSequence> Algo::getTunings(const ChordSequence& seq, const Options& options, int* val) {
+    return getTunings(seq, "", 0, options, val);
+}
+
+std::vector<TuningSequence> Algo::getTunings(const ChordSequence& seq, const std::string& file, unsigned int interval, int* val) {
+    return getTunings(seq, file, interval, Options{}, val);
+}
+
+std::vector<TuningSequence> Algo::getTunings(const ChordSequence& seq, const std::string& file, unsigned int interval, const Options& options, int* val) {
+    return Solver{options}.getTunings(seq, file, interval, val);
+}
+
+std::vector<TuningSequence> Algo::getTuningsAfter(const Tuning& prev, const ChordSequence& seq, const Options& options, int* val) {
+    return Solver{options}.getTuningsAfter(prev, seq, val);
+}
+
+std::vector<std::vector<TuningSequence>> Algo::getTunings(std::list<std::list<EPitch>> seq, const std::vector<Interval>& profiles, std::vector<int>* values) {
+    std::vector<EPitch> pitches;
+    std::vector<unsigned int> offsets;
+    flatten(seq, pitches, offsets);
+    return getTunings(ChordSequence{pitches.data(), offsets.data(), static_cast<unsigned int>(seq.size())}, profiles, values);
+}
+
+std::vector<std::vector<TuningSequence>> Algo::getTunings(const ChordSequence& seq, const std::vector<Interval>& profiles, std::vector<int>* values) {
+    return Solver{}.getTunings(seq, profiles, values);
 }
@@ -1,17 +1,19 @@
 #ifndef _ALGO_H_
 #define _ALGO_H_
 
+#include <cstdint>
 #include <vector>
 #include <list>
 #include <map>
 #include <unordered_map>
-#include <unordered_set>
-
-#include "hash.h"
+#include <string>
 
 struct EPitch;
+struct PitchSpan;
+struct ChordSequence;
 class Tuning;
 class TuningSequence;
+class Interval;
 
 
 namespace Algo {
@@ -27,15 +29,107 @@ namespace Algo {
     //   of the fixed Tuning given. If the fixed Tuning does not contain any pitches,
     //   an arbitrary note in the variable pitches is chosen to be the baseline
     //   pitch.
-    std::map<Tuning, int> getValuesRec(const Tuning& fixed, std::list<EPitch> var,
-        std::unordered_map<EPitch, std::unordered_set<NoteTuning, Hash>, Hash> calculated =
-        std::unordered_map<EPitch, std::unordered_set<NoteTuning, Hash>, Hash>());
+	// The variable pitches can also be given as a PitchSpan (e.g. one chord of
+	//   a ChordSequence), which avoids building a list.
+    std::map<Tuning, int> getValuesRec(const Tuning& fixed, const std::list<EPitch>& var);
+    std::map<Tuning, int> getValuesRec(const Tuning& fixed, const PitchSpan& var);
+
+	// Returns the value of the given tuning of variable pitches against the given
+	//   fixed pitches, in the same way getValuesRec computes it: the sum of the
+	//   weights of every interval (between a fixed pitch and a variable pitch,
+	//   or between two variable pitches) that is tuned in its ideal ratio
+    int evaluate(const Tuning& fixed, const Tuning& tuning);
+
+	// Same as above, but with the ideal ratios and weights of the given
+	//   interval table (see getValuesMulti)
+    int evaluate(const Tuning& fixed, const Tuning& tuning, const Interval& intervals);
+
+	// Ways of joining the components solved by getValuesDecomposed
+    enum class Decomposition {Exact, Fast};
+
+	// Same as getValuesRec, except that the variable pitches are first split
+	//   into the connected components of their interval graph, in which two
+	//   pitches are connected if the weight of the interval between them is
+	//   larger than threshold. Each component is solved against the fixed
+	//   pitches independently (on the calling thread, unless a component has
+	//   at least parallelPitches pitches, in which case they are solved on
+	//   shared threads), and then the best tunings of the components are
+	//   joined by evaluating every interval between components. If there are
+	//   no fixed pitches, each component is aligned to the ones before it by
+	//   every scale that maximizes that value. Only the joined tunings are
+	//   returned, so tunings that are not the best on every component are
+	//   missing from the map.
+	// In Exact mode, the components are joined one at a time, and the result
+	//   is only returned if the best joined value reaches the sum of the best
+	//   values of the components and of the weights of every interval between
+	//   them, which no tuning of the chord can exceed. Only the tunings with
+	//   that value are returned, which are the best tunings getValuesRec
+	//   finds. Chords that cannot reach it are detected cheaply first
+	//   (by joining the single tunings Greedy finds for the components), and
+	//   are solved by getValuesRec instead. If there are no fixed pitches, the
+	//   first pitch is tuned first, as getValuesRec does, and the rest are
+	//   split against it.
+	// In Fast mode, the result is always returned. Some value may be lost on
+	//   the intervals that are not above the threshold.
+	// If joined is non-null, it is set to whether the result was joined from
+	//   the components (false if there is a single component, or if Exact
+	//   mode fell back to getValuesRec).
+    std::map<Tuning, int> getValuesDecomposed(const Tuning& fixed, const std::list<EPitch>& var, Decomposition mode, int threshold = 4, bool* joined = nullptr);
+
+	// Smallest number of pitches in a component that getValuesDecomposed
+	//   solves on shared threads
+    const unsigned int parallelPitches = 10;
+
+	// Largest number of profiles the multi-profile searches below accept,
+	//   which is the number of bits of the masks they track profiles with
+    const unsigned int maxProfiles = 64;
+
+	// Quality tiers of the solvers, from the slowest to the fastest. Exact
+	//   finds every tuning that getValuesRec does. Pruned does not branch
+	//   through intervals with weight at most the threshold of the options
+	//   (with the standard weights and the default threshold, tritones and
+	//   minor seconds): a pitch is only tuned through such an interval when
+	//   there is no better one to tune it through. Greedy tunes one pitch at
+	//   a time through the best interval to a pitch that is already tuned,
+	//   without branching, and finds a single tuning in O(n^2) time for n
+	//   pitches.
+    enum class Tier {Exact, Pruned, Greedy};
+
+	// Options accepted by the solvers below, which trade the value of the
+	//   tunings found for speed
+    struct Options {
+        Tier tier = Tier::Exact;
+        int threshold = 4;
+
+		// Number of tunings the sequence solvers keep after every chord (the
+		//   best ones), or 0 to keep every tuning
+        unsigned int trim = 8;
+
+		// Whether chords are split into components over the threshold before
+		//   they are searched (see getValuesDecomposed), in Exact mode with the
+		//   Exact tier and in Fast mode with the Pruned tier, whose components
+		//   are searched with that tier. Ignored by the Greedy tier. A chord
+		//   that is split only keeps the tunings that are the best on every
+		//   component, so the sequence solvers have fewer tunings to follow
+		//   through it, even with the Exact tier.
+        bool decompose = false;
+    };
+
+	// Returns true if the two options search a chord the same way (they have
+	//   the same tier, threshold and decomposition), so that the expansions
+	//   found with one can be reused with the other
+    bool sameSearch(const Options&, const Options&);
+
+	// Same as getValuesRec, but searches with the tier of the given options
+	//   (see getBestValues)
+    std::map<Tuning, int> getValuesRec(const Tuning& fixed, const PitchSpan& var, const Options& options);
 
 	// Given a Tuning object that represents fixed pitches and a list of EPitch
 	//   objects that represents variable pitches, return a multimap that maps
 	//   an integer to every Tuning object that has that value. See getValuesRec
 	//   for the specifications of the Tuning objects produced.
     std::multimap<int, Tuning> getValues(const Tuning& fixed, const std::list<EPitch>& var);
+    std::multimap<int, Tuning> getValues(const Tuning& fixed, const PitchSpan& var);
 
 	// Given a Tuning object that represents fixed pitches and a list of EPitch
 	//   objects that represents variable pitches, return a vector of Tuning
@@ -43,12 +137,43 @@ namespace Algo {
 	//   with optimal value. See getValuesRec for the specifications of the Tuning
 	//   objects.
     std::vector<Tuning> getBestValues(const Tuning& fixed, const std::list<EPitch>& var);
+    std::vector<Tuning> getBestValues(const Tuning& fixed, const PitchSpan& var);
+
+	// Same as above, but searches with the tier of the given options. The
+	//   tunings returned are the best ones that tier found, which may not be
+	//   optimal unless the tier is Exact.
+    std::vector<Tuning> getBestValues(const Tuning& fixed, const std::list<EPitch>& var, const Options& options);
+    std::vector<Tuning> getBestValues(const Tuning& fixed, const PitchSpan& var, const Options& options);
+
+	// Same as getValuesRec, but searches with each of the given interval
+	//   tables (profiles) at once, mapping every tuning to a vector with one
+	//   value per profile. Only the profiles whose bits are set in active are
+	//   searched. There must be between 1 and maxProfiles profiles, or
+	//   std::invalid_argument is thrown. A branch chosen by
+	//   several profiles is explored once for all of them, and congruence tests
+	//   are shared between profiles that have the same ideal ratio for an
+	//   interval, so profiles that mostly agree cost little more than one.
+	//   A branch left with a single profile is searched as getValuesRec
+	//   searches it, so one profile costs the same as getValuesRec.
+	//   A tuning that was not reached by the search of a profile has the
+	//   value -1 for that profile.
+    std::map<Tuning, std::vector<int>> getValuesMulti(const Tuning& fixed, const std::list<EPitch>& var, const std::vector<Interval>& profiles, unsigned long active = ~0ul);
+    std::map<Tuning, std::vector<int>> getValuesMulti(const Tuning& fixed, const PitchSpan& var, const std::vector<Interval>& profiles, unsigned long active = ~0ul);
+
+	// Same as getBestValues, but returns the optimal tunings for each of the
+	//   given profiles (see getValuesMulti), in the same order as the profiles
+    std::vector<std::vector<Tuning>> getBestValues(const Tuning& fixed, const std::list<EPitch>& var, const std::vector<Interval>& profiles);
+    std::vector<std::vector<Tuning>> getBestValues(const Tuning& fixed, const PitchSpan& var, const std::vector<Interval>& profiles);
 
-	// Internal function
-    std::vector<TuningSequence> getTuningsRec(std::multimap<int, Tuning> prev, std::list<std::list<EPitch>> next, int& value, unsigned int trim = 0);
+	// Internal function. Returns a hash identifying the given sequence of
+	//   pitches, trim and options, used to match checkpoints to the solve that
+	//   wrote them
+    unsigned long fingerprint(const ChordSequence& seq, unsigned int trim, const Options& options);
 
 	// Returns a vector of TuningSequences with optimal value given a sequence of
 	//   pitches
+	// The sequence solvers below each solve with a new Algo::Solver (see
+	//   solver.h), which can be kept instead to reuse its caches between solves.
 	// The sequence of pitches is a list of lists of pitches in the following
 	//   format: every element of the outer list is a new collection of
 	//   simultaneous notes directly following the previous collection of
@@ -68,6 +193,56 @@ namespace Algo {
 	// If the second argument is passed in and is non-null, the value of the
 	//   pointer will be set to the value of the optimal tuning sequences.
     std::vector<TuningSequence> getTunings(std::list<std::list<EPitch>> seq, int* value = nullptr);
+
+	// Same as above, but the sequence of pitches is given as a ChordSequence,
+	//   which is read in place: no lists are built and no part of the sequence
+	//   is copied during the solve. The overloads that take a list of lists
+	//   flatten it into a ChordSequence and call these.
+	// A chord of the ChordSequence that lasts several beats (see
+	//   ChordSequence::counts) is solved as one step, which has a single
+	//   Tuning in the sequences returned, but is valued as that many beats
+	//   tuned the same way: its tuning counts once against the chord before it
+	//   and once more against itself for every beat after the first.
+    std::vector<TuningSequence> getTunings(const ChordSequence& seq, int* value = nullptr);
+
+	// Same as above, but every chord is searched with the tier of the given
+	//   options (see getBestValues), so the sequences returned may not be
+	//   optimal unless the tier is Exact. The value is that of the sequences
+	//   returned.
+    std::vector<TuningSequence> getTunings(std::list<std::list<EPitch>> seq, const Options& options, int* value = nullptr);
+    std::vector<TuningSequence> getTunings(const ChordSequence& seq, const Options& options, int* value = nullptr);
+
+	// Same as above, but the sequence continues from the given tuning of the
+	//   chord before it (e.g. a solution of the preceding passage), which the
+	//   first chord is tuned against. The sequences returned do not include
+	//   that tuning, and their value includes the intervals between it and the
+	//   first chord.
+    std::vector<TuningSequence> getTuningsAfter(const Tuning& prev, const ChordSequence& seq, const Options& options = Options{}, int* value = nullptr);
+
+	// Same as above, but solves the sequence for each of the given profiles
+	//   (see getValuesMulti) in one shared search, returning the optimal
+	//   TuningSequences for each profile in the same order as the profiles.
+	//   Every profile keeps its own frontier, but a tuning that is in the
+	//   frontier of several profiles is only expanded once (for all of those
+	//   profiles), and expansions are cached by normalized tuning as in the
+	//   other sequence solvers. Profiles only share the tunings they both
+	//   reach, so a profile with other ideal ratios (e.g. a 7/4 minor
+	//   seventh) costs about as much as solving it separately, while one that
+	//   only reweighs some intervals costs a fraction of that. There must be
+	//   between 1 and maxProfiles profiles, or std::invalid_argument is
+	//   thrown. If the last argument is non-null, it is filled with the value
+	//   of each profile's optimal tuning sequences.
+    std::vector<std::vector<TuningSequence>> getTunings(std::list<std::list<EPitch>> seq, const std::vector<Interval>& profiles, std::vector<int>* values = nullptr);
+    std::vector<std::vector<TuningSequence>> getTunings(const ChordSequence& seq, const std::vector<Interval>& profiles, std::vector<int>* values = nullptr);
+
+	// Same as above, but the progress of the solve is saved to the given file
+	//   after every interval chords (see Checkpoint). If the file already
+	//   contains progress saved by an interrupted solve of the same sequence,
+	//   the solve resumes from there instead of from the first chord. The file
+	//   is removed once the solve finishes.
+    std::vector<TuningSequence> getTunings(std::list<std::list<EPitch>> seq, const std::string& file, unsigned int interval, int* value = nullptr);
+    std::vector<TuningSequence> getTunings(const ChordSequence& seq, const std::string& file, unsigned int interval, int* value = nullptr);
+    std::vector<TuningSequence> getTunings(const ChordSequence& seq, const std::string& file, unsigned int interval, const Options& options, int* value = nullptr);
 }
 
 #endif
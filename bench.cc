@@ -0,0 +1,1149 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <random>
+#include <string>
+#include <list>
+#include <vector>
+#include <cstdio>
+#include <algorithm>
+#include <memory>
+#include <map>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <thread>
+#include <atomic>
+#include <stdexcept>
+#include <csignal>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+#include "frac.h"
+#include "pitch.h"
+#include "interval.h"
+#include "tunings.h"
+#include "algo.h"
+#include "solver.h"
+#include "score.h"
+#include "midi.h"
+#include "scoretext.h"
+#include "tuningfile.h"
+#include "diskcache.h"
+#include "pairs.h"
+#include "workers.h"
+#include "trace.h"
+
+using namespace std::chrono;
+
+// Helpers defined in algo.cc
+std::list<std::pair<NoteTuning, EPitch>> findPairsToCheck(const Tuning& fixed, const std::vector<EPitch>& var, const Interval& intervals);
+std::vector<std::vector<EPitch>> findComponents(const std::vector<EPitch>& pitches, int threshold);
+
+// Returns a random chord of k distinct pitches between octaves 2 and 5
+std::list<EPitch> randomChord(std::mt19937& gen, unsigned int k) {
+    std::uniform_int_distribution<int> pitch(0, 11);
+    std::uniform_int_distribution<int> octave(2, 5);
+    std::list<EPitch> chord;
+    while (chord.size() < k) {
+        EPitch ep{static_cast<Pitch>(pitch(gen)), octave(gen)};
+        if (std::find(chord.begin(), chord.end(), ep) == chord.end()) {
+            chord.emplace_back(ep);
+        }
+    }
+    return chord;
+}
+
+// Returns a random sequence of n chords, each with between 1 and k pitches
+std::list<std::list<EPitch>> randomSequence(std::mt19937& gen, unsigned int n, unsigned int k) {
+    std::uniform_int_distribution<unsigned int> size(1, k);
+    std::list<std::list<EPitch>> seq;
+    for (unsigned int i = 0; i < n; i++) {
+        seq.emplace_back(randomChord(gen, size(gen)));
+    }
+    return seq;
+}
+
+// Returns a format 1 Standard MIDI File with the given number of tracks, each
+//   playing the given number of random notes with running status
+std::string randomMidi(std::mt19937& gen, unsigned int tracks, unsigned int notes) {
+    std::uniform_int_distribution<int> key(36, 84);
+    std::uniform_int_distribution<int> length(1, 4);
+    auto fixed = [](std::string& out, uint32_t n, int bytes) {
+        for (int i = bytes - 1; i >= 0; i--) out.push_back(static_cast<char>((n >> (8 * i)) & 0xff));
+    };
+    auto varLen = [](std::string& out, uint32_t n) {
+        int shift = 21;
+        while (shift > 0 && !(n >> shift)) shift -= 7;
+        for (; shift > 0; shift -= 7) out.push_back(static_cast<char>(0x80 | ((n >> shift) & 0x7f)));
+        out.push_back(static_cast<char>(n & 0x7f));
+    };
+
+    std::string midi = "MThd";
+    fixed(midi, 6, 4);
+    fixed(midi, 1, 2);
+    fixed(midi, tracks, 2);
+    fixed(midi, 480, 2);
+    for (unsigned int t = 0; t < tracks; t++) {
+        std::string track;
+        track.push_back(0);
+        track.push_back(static_cast<char>(0x90 | (t % 9)));
+        for (unsigned int n = 0; n < notes; n++) {
+            char k = static_cast<char>(key(gen));
+            if (n > 0) varLen(track, 0);
+            track.push_back(k);
+            track.push_back(100);
+            varLen(track, 120 * length(gen));
+            track.push_back(k);
+            track.push_back(0);
+        }
+        track += std::string{"\0\xff\x2f\0", 4};
+        midi += "MTrk";
+        fixed(midi, track.size(), 4);
+        midi += track;
+    }
+    return midi;
+}
+
+// The name and the time in microseconds of every measurement taken, in the
+//   order they were taken
+std::vector<std::pair<std::string, double>> results;
+
+// Returns the shortest time in microseconds taken by f over the given number
+//   of runs, and records it under the given name
+template<typename F> double time(const std::string& name, F f, int runs) {
+    double best = -1;
+    for (int i = 0; i < runs; i++) {
+        auto start = steady_clock::now();
+        f();
+        double t = duration_cast<nanoseconds>(steady_clock::now() - start).count() / 1000.0;
+        if (best < 0 || t < best) best = t;
+    }
+    results.emplace_back(name, best);
+    return best;
+}
+
+// The number of checks made by the benchmarks that failed. bench fails if any
+//   did.
+unsigned int failures = 0;
+
+// Counts the check with the given description as failed, and prints it,
+//   unless it passed
+void check(bool passed, const std::string& what) {
+    if (passed) return;
+    failures++;
+    std::cout << "  FAILED: " << what << std::endl;
+}
+
+// Returns the given sequences and their value as text, so that the results of
+//   two solves can be compared
+std::string describe(const std::vector<TuningSequence>& sequences, int value) {
+    std::ostringstream out;
+    out << value << "\n";
+    for (const TuningSequence& ts : sequences) out << ts << "--\n";
+    return out.str();
+}
+
+void benchFrac() {
+    std::mt19937 gen(2044);
+    std::uniform_int_distribution<unsigned long> term(1, 64);
+    std::vector<Frac> fracs;
+    for (int i = 0; i < 4096; i++) fracs.emplace_back(term(gen), term(gen));
+    const int runs = 7;
+
+    unsigned long sum = 0;
+    double multiply = time("frac/multiply", [&]() {
+        for (unsigned int i = 0; i + 1 < fracs.size(); i++) sum += (fracs[i] * fracs[i + 1]).p;
+    }, runs);
+    double divide = time("frac/divide", [&]() {
+        for (unsigned int i = 0; i + 1 < fracs.size(); i++) sum += (fracs[i] / fracs[i + 1]).q;
+    }, runs);
+    double adjust = time("frac/adjust", [&]() {
+        for (const Frac& frac : fracs) sum += frac.adjust().p;
+    }, runs);
+    std::vector<Frac> sorted;
+    double sort = time("frac/sort", [&]() {
+        sorted = fracs;
+        std::sort(sorted.begin(), sorted.end());
+    }, runs);
+    std::cout << "Frac (" << fracs.size() << " fractions): multiply " << multiply << " us, divide " << divide
+              << " us, adjust " << adjust << " us, sort " << sort << " us" << std::endl;
+}
+
+void benchPairs() {
+    std::mt19937 gen(2045);
+    const int runs = 5;
+    for (unsigned int k : {4u, 6u, 8u}) {
+        std::vector<Tuning> fixed;
+        std::vector<std::vector<EPitch>> vars;
+        for (int i = 0; i < 200; i++) {
+            fixed.emplace_back(Algo::getBestValues(Tuning{}, randomChord(gen, 3))[0]);
+            std::list<EPitch> var = randomChord(gen, k);
+            vars.emplace_back(var.begin(), var.end());
+        }
+        std::size_t pairs = 0;
+        double t = time("pairs/findPairsToCheck-" + std::to_string(k), [&]() {
+            pairs = 0;
+            for (unsigned int i = 0; i < fixed.size(); i++) pairs += findPairsToCheck(fixed[i], vars[i], Interval::standard()).size();
+        }, runs);
+        std::cout << "findPairsToCheck (200 chords of " << k << " pitches after 3 fixed): " << t << " us, "
+                  << pairs << " pairs" << std::endl;
+    }
+
+	// PairQueue must give the same pairs as findPairsToCheck at every step of
+	//   a walk that fixes the pitches of a chord one at a time, including
+	//   chords larger than an octave, whose pitches share pitch classes
+    std::uniform_int_distribution<unsigned long> term(1, 16);
+    for (unsigned int k : {4u, 8u, 12u, 16u, 24u}) {
+        std::vector<Tuning> fixed;
+        std::vector<std::vector<EPitch>> vars;
+        for (int i = 0; i < 100; i++) {
+            std::list<EPitch> chord = randomChord(gen, k + 3);
+            Tuning tuning;
+            for (unsigned int j = 0; j < 3; j++) {
+                tuning.addNoteTuning(NoteTuning{chord.front(), Frac{term(gen), term(gen)}});
+                chord.pop_front();
+            }
+            fixed.emplace_back(tuning);
+            vars.emplace_back(chord.begin(), chord.end());
+        }
+        bool same = true;
+        double slow = time("pairs/walk-findPairsToCheck-" + std::to_string(k), [&]() {
+            for (unsigned int i = 0; i < fixed.size(); i++) {
+                Tuning tuning = fixed[i];
+                std::vector<EPitch> var = vars[i];
+                while (!var.empty()) {
+                    findPairsToCheck(tuning, var, Interval::standard());
+                    tuning.addNoteTuning(NoteTuning{var.back(), Frac{1, 1}});
+                    var.pop_back();
+                }
+            }
+        }, runs);
+        double fast = time("pairs/walk-PairQueue-" + std::to_string(k), [&]() {
+            for (unsigned int i = 0; i < fixed.size(); i++) {
+                Tuning tuning = fixed[i];
+                PairQueue queue{tuning, vars[i], Interval::standard()};
+                for (unsigned int j = vars[i].size(); j-- > 0;) {
+                    queue.pairs(tuning);
+                    NoteTuning nt{vars[i][j], Frac{1, 1}};
+                    tuning.addNoteTuning(nt);
+                    queue.fix(nt);
+                }
+            }
+        }, runs);
+        for (unsigned int i = 0; i < fixed.size() && same; i++) {
+            Tuning tuning = fixed[i];
+            std::vector<EPitch> var = vars[i];
+            PairQueue queue{tuning, var, Interval::standard()};
+            while (!var.empty() && same) {
+                same = queue.pairs(tuning) == findPairsToCheck(tuning, var, Interval::standard());
+                NoteTuning nt{var.back(), Frac{term(gen), term(gen)}};
+                tuning.addNoteTuning(nt);
+                queue.fix(nt);
+                var.pop_back();
+            }
+        }
+        check(same, "PairQueue gives the pairs of findPairsToCheck for chords of " + std::to_string(k) + " pitches");
+        std::cout << "Pair walks (100 chords of " << k << " pitches after 3 fixed): findPairsToCheck " << slow
+                  << " us, PairQueue " << fast << " us" << std::endl;
+    }
+}
+
+void benchValues() {
+    const int runs = 3;
+    for (unsigned int k : {3u, 5u, 7u}) {
+        std::mt19937 gen(2046);
+        std::vector<std::list<EPitch>> chords;
+        for (int i = 0; i < 20; i++) chords.emplace_back(randomChord(gen, k));
+        double rec = time("values/getValuesRec-" + std::to_string(k), [&]() {
+            for (const std::list<EPitch>& chord : chords) Algo::getValuesRec(Tuning{}, chord);
+        }, runs);
+        double best = time("values/getBestValues-" + std::to_string(k), [&]() {
+            for (const std::list<EPitch>& chord : chords) Algo::getBestValues(Tuning{}, chord);
+        }, runs);
+        std::cout << "20 chords of " << k << " pitches: getValuesRec " << rec << " us, getBestValues " << best
+                  << " us" << std::endl;
+    }
+}
+
+void benchProgressions() {
+    const int runs = 3;
+    for (unsigned int n : {25u, 100u}) {
+        for (unsigned int k : {2u, 4u, 6u}) {
+            std::mt19937 gen(2047);
+            std::list<std::list<EPitch>> seq = randomSequence(gen, n, k);
+            double t = time("progressions/getTunings-" + std::to_string(n) + "x" + std::to_string(k), [&]() {
+                Algo::getTunings(seq);
+            }, runs);
+            std::cout << "getTunings (" << n << " chords of 1-" << k << " pitches): " << t << " us" << std::endl;
+        }
+    }
+}
+
+void benchSample() {
+    Score score = SAMPLE_SONG;
+    double t = time("sample/calculateFreqs", [&]() { score.calculateFreqs(); }, 7);
+    std::cout << "calculateFreqs (SAMPLE_SONG, " << score.getLength() << " beats): " << t << " us" << std::endl;
+}
+
+void benchCheckpoint() {
+    std::mt19937 gen(2024);
+    std::list<std::list<EPitch>> seq = randomSequence(gen, 200, 4);
+    const std::string file = "bench_checkpoint.bin";
+    const int runs = 7;
+
+    double base = time("checkpoint/none", [&]() { Algo::getTunings(seq); }, runs);
+    std::cout << "getTunings (200 chords): " << base << " us" << std::endl;
+
+    for (unsigned int interval : {1u, 8u, 64u}) {
+        double t = time("checkpoint/every-" + std::to_string(interval), [&]() { Algo::getTunings(seq, file, interval); }, runs);
+        std::cout << "  checkpoint every " << interval << " chords: " << t << " us ("
+                  << (t - base) / base * 100 << "% overhead)" << std::endl;
+    }
+    std::remove(file.c_str());
+}
+
+void benchResume() {
+	// A solve is interrupted by killing it once its checkpoint reaches a given
+	//   size, which leaves the last record torn at an arbitrary byte, then
+	//   resumed. The solve is run in a child process whose files cannot grow
+	//   past that size, so it dies on the write that would.
+    std::mt19937 gen(2026);
+    std::list<std::list<EPitch>> seq = randomSequence(gen, 60, 4);
+    const std::string file = "bench_resume.bin";
+    std::signal(SIGXFSZ, SIG_DFL);
+
+    int value;
+    std::vector<TuningSequence> reference = Algo::getTunings(seq, &value);
+    const std::string expected = describe(reference, value);
+
+    unsigned int resumed = 0;
+    for (unsigned int interval : {1u, 5u}) {
+        for (rlim_t size = 40; ; size = size * 3 / 2 + 7) {
+            std::remove(file.c_str());
+            pid_t child = fork();
+            if (child == 0) {
+                struct rlimit limit{size, size};
+                setrlimit(RLIMIT_FSIZE, &limit);
+                Algo::getTunings(seq, file, interval);
+                _exit(0);
+            }
+            int status;
+            waitpid(child, &status, 0);
+			// The solve finished before its checkpoint reached the size
+            if (WIFEXITED(status)) break;
+
+            std::vector<TuningSequence> sequences = Algo::getTunings(seq, file, interval, &value);
+            check(describe(sequences, value) == expected,
+                  "solve resumed after " + std::to_string(size) + " bytes of checkpoint (every " + std::to_string(interval) + " chords) differs");
+            check(!std::ifstream{file}, "checkpoint left after the resumed solve");
+            resumed++;
+        }
+    }
+    std::remove(file.c_str());
+    double t = time("resume/getTunings", [&]() { Algo::getTunings(seq, file, 1); }, 7);
+    std::cout << "getTunings resumed from " << resumed << " interrupted checkpoints (60 chords; solve with checkpoint every chord "
+              << t << " us)" << std::endl;
+}
+
+void benchChromatic() {
+	// A chromatic passage of major thirds over a held bass, whose frontier
+	//   is full of tunings that only differ by a comma
+    std::list<std::list<EPitch>> seq;
+    for (int i = 0; i < 96; i++) {
+        seq.emplace_back(std::list<EPitch>{EPitch{Pitch::C, 3}, EPitch{static_cast<Pitch>(i % 12), 4}, EPitch{static_cast<Pitch>((i + 4) % 12), 4}});
+    }
+    double t = time("chromatic/getTunings", [&]() { Algo::getTunings(seq); }, 7);
+    std::cout << "getTunings (96 chromatic chords): " << t << " us" << std::endl;
+}
+
+// Returns a chord of two clusters of pitch classes a tritone apart (a major
+//   third, and the major third a tritone above it), doubled in random octaves,
+//   which only the intervals within the clusters join at a threshold of 8
+std::list<EPitch> clusterChord(std::mt19937& gen) {
+    std::uniform_int_distribution<int> root(0, 11);
+    std::bernoulli_distribution doubled(0.5);
+    int r = root(gen);
+    std::list<EPitch> chord;
+    for (int offset : {0, 4, 6, 10}) {
+        chord.emplace_back(EPitch{static_cast<Pitch>((r + offset) % 12), 3});
+        for (int octave : {2, 4}) {
+            if (doubled(gen)) chord.emplace_back(EPitch{static_cast<Pitch>((r + offset) % 12), octave});
+        }
+    }
+    return chord;
+}
+
+// Returns the best tunings of the given map as text, in order, so that the
+//   results of two searches can be compared
+std::string bestTunings(const std::map<Tuning, int>& m) {
+    int best = -1;
+    for (auto& pair : m) best = std::max(best, pair.second);
+    std::ostringstream out;
+    out << best;
+    for (auto& pair : m) {
+        if (pair.second == best) out << " " << pair.first;
+    }
+    return out.str();
+}
+
+void benchDecomposition() {
+	// Random chords that split into several components at the threshold, and
+	//   at a threshold of 8 chords of clusters (which a threshold of 4 does
+	//   not split), half of them against a tuned context
+    std::mt19937 gen(2025);
+    const int runs = 3;
+    for (int threshold : {4, 8}) {
+        std::vector<std::list<EPitch>> chords;
+        std::vector<Tuning> contexts;
+        while (chords.size() < 60) {
+            std::list<EPitch> chord = threshold < 8 || chords.size() < 40 ? randomChord(gen, 4 + chords.size() % 4) : clusterChord(gen);
+            if (findComponents(std::vector<EPitch>{chord.begin(), chord.end()}, threshold).size() < 2) continue;
+            chords.emplace_back(chord);
+            contexts.emplace_back(chords.size() % 2 ? Algo::getBestValues(Tuning{}, randomChord(gen, 2))[0] : Tuning{});
+        }
+
+        std::vector<std::string> expected;
+        double base = time("decomposition/getValuesRec-" + std::to_string(threshold), [&]() {
+            expected.clear();
+            for (unsigned int i = 0; i < chords.size(); i++) expected.emplace_back(bestTunings(Algo::getValuesRec(contexts[i], chords[i])));
+        }, runs);
+        long total = 0;
+        for (const std::string& e : expected) total += std::atol(e.c_str());
+        std::cout << "getValuesRec (60 chords with components at threshold " << threshold << "): " << base << " us" << std::endl;
+
+        for (Algo::Decomposition mode : {Algo::Decomposition::Exact, Algo::Decomposition::Fast}) {
+            std::string name = mode == Algo::Decomposition::Exact ? "exact" : "fast";
+            long value = 0;
+            unsigned int joined = 0;
+            double t = time("decomposition/" + name + "-" + std::to_string(threshold), [&]() {
+                value = 0;
+                joined = 0;
+                for (unsigned int i = 0; i < chords.size(); i++) {
+                    bool j;
+                    std::string best = bestTunings(Algo::getValuesDecomposed(contexts[i], chords[i], mode, threshold, &j));
+                    value += std::atol(best.c_str());
+                    if (j) joined++;
+                    if (mode == Algo::Decomposition::Exact) {
+                        check(best == expected[i], "exact decomposition of chord " + std::to_string(i) + " differs from getValuesRec");
+                    }
+                }
+            }, runs);
+            std::cout << "  " << name << " decomposition: " << t << " us (" << base / t << "x), joined " << joined << " of "
+                      << chords.size() << " chords (" << (chords.size() - joined) * 100.0 / chords.size() << "% fell back), value loss "
+                      << (total - value) * 100.0 / total << "%" << std::endl;
+        }
+    }
+
+	// The pass as an option of the sequence solvers, on a sequence of cluster
+	//   chords
+    std::list<std::list<EPitch>> seq;
+    for (int i = 0; i < 8; i++) seq.emplace_back(clusterChord(gen));
+    for (Algo::Tier tier : {Algo::Tier::Exact, Algo::Tier::Pruned}) {
+        std::string name = tier == Algo::Tier::Exact ? "exact" : "pruned";
+        Algo::Options options{tier, 8};
+        int plain = 0;
+        int decomposed = 0;
+        double t = time("decomposition/getTunings-" + name, [&]() { Algo::getTunings(seq, options, &plain); }, runs);
+        options.decompose = true;
+        double d = time("decomposition/getTunings-" + name + "-decomposed", [&]() { Algo::getTunings(seq, options, &decomposed); }, runs);
+        std::cout << "getTunings (8 cluster chords), " << name << " tier, threshold 8: " << t << " us, decomposed " << d << " us ("
+                  << t / d << "x), value loss " << (plain - decomposed) * 100.0 / plain << "%" << std::endl;
+    }
+}
+
+void benchProfiles() {
+	// Profiles with a 7/4 minor seventh reach tunings that the others never
+	//   do, so they share little of their search with them; profiles that only
+	//   reweigh some intervals mostly reach the same tunings
+    std::mt19937 gen(2026);
+    std::list<std::list<EPitch>> seq = randomSequence(gen, 40, 4);
+    std::vector<std::pair<std::string, std::vector<Interval>>> sets{
+        {"", {
+            Interval{},
+            Interval{}.setIdealRatio(10, Frac{7, 4}),
+            Interval{}.setIdealRatio(10, Frac{7, 4}).setWeight(10, 30),
+            Interval{}.setWeight(8, 20)
+        }},
+        {"reweighed-", {
+            Interval{},
+            Interval{}.setWeight(8, 20),
+            Interval{}.setWeight(3, 32).setWeight(9, 32),
+            Interval{}.setWeight(2, 16).setWeight(10, 16)
+        }}
+    };
+    const int runs = 5;
+
+    for (auto& set : sets) {
+        const std::vector<Interval>& profiles = set.second;
+        double single = 0;
+        for (unsigned int k = 1; k <= profiles.size(); k++) {
+            std::vector<Interval> first{profiles.begin(), profiles.begin() + k};
+            double separate = time("profiles/" + set.first + "separate-" + std::to_string(k), [&]() {
+                for (const Interval& profile : first) Algo::getTunings(seq, std::vector<Interval>{profile});
+            }, runs);
+            double joint = time("profiles/" + set.first + "shared-" + std::to_string(k), [&]() { Algo::getTunings(seq, first); }, runs);
+            if (k == 1) single = joint;
+            std::cout << "getTunings (40 chords), " << k << " " << set.first << "profiles: separate " << separate << " us, shared "
+                      << joint << " us (" << separate / joint << "x, " << joint / single << " solves)" << std::endl;
+        }
+    }
+
+	// The searches track profiles in 64-bit masks, so more profiles (or none)
+	//   are rejected rather than aliased
+    std::list<EPitch> chord{EPitch{Pitch::C, 4}, EPitch{Pitch::E, 4}, EPitch{Pitch::G, 4}};
+    std::list<std::list<EPitch>> shortSeq{chord, chord};
+    for (std::size_t k : {std::size_t{0}, std::size_t{Algo::maxProfiles + 1}}) {
+        std::vector<Interval> profiles(k);
+        bool rejected = true;
+        try {
+            Algo::getValuesMulti(Tuning{}, chord, profiles);
+            rejected = false;
+        } catch (const std::invalid_argument&) {}
+        try {
+            Algo::getTunings(shortSeq, profiles);
+            rejected = false;
+        } catch (const std::invalid_argument&) {}
+        check(rejected, std::to_string(k) + " profiles are rejected");
+    }
+    std::vector<int> values;
+    check(Algo::getTunings(shortSeq, std::vector<Interval>(Algo::maxProfiles), &values).size() == Algo::maxProfiles
+          && values.front() == values.back(), std::to_string(Algo::maxProfiles) + " profiles are solved");
+}
+
+void benchTiers() {
+    std::mt19937 gen(2027);
+    std::vector<std::list<EPitch>> chords;
+    std::vector<Tuning> contexts;
+    for (int i = 0; i < 40; i++) {
+        chords.emplace_back(randomChord(gen, 5 + i % 4));
+        contexts.emplace_back(i % 2 ? Algo::getBestValues(Tuning{}, randomChord(gen, 2))[0] : Tuning{});
+    }
+    std::list<std::list<EPitch>> seq = randomSequence(gen, 40, 4);
+    const int runs = 3;
+
+    long exactValue = 0;
+    int exactSeqValue = 0;
+    for (Algo::Tier tier : {Algo::Tier::Exact, Algo::Tier::Pruned, Algo::Tier::Greedy}) {
+        Algo::Options options{tier};
+        std::string name = tier == Algo::Tier::Exact ? "exact" : tier == Algo::Tier::Pruned ? "pruned" : "greedy";
+        long value = 0;
+        double t = time("tiers/getBestValues-" + name, [&]() {
+            value = 0;
+            for (unsigned int i = 0; i < chords.size(); i++) {
+                value += Algo::evaluate(contexts[i], Algo::getBestValues(contexts[i], chords[i], options)[0]);
+            }
+        }, runs);
+        int seqValue = 0;
+        double seqT = time("tiers/getTunings-" + name, [&]() { Algo::getTunings(seq, options, &seqValue); }, runs);
+        if (tier == Algo::Tier::Exact) {
+            exactValue = value;
+            exactSeqValue = seqValue;
+        }
+        std::cout << name << " tier: getBestValues (40 chords of 5-8 pitches) " << t << " us, value loss "
+                  << (exactValue - value) * 100.0 / exactValue << "%; getTunings (40 chords) " << seqT
+                  << " us, value loss " << (exactSeqValue - seqValue) * 100.0 / exactSeqValue << "%" << std::endl;
+    }
+}
+
+// Returns a dense score of the given number of bars of four beats: a triad
+//   held for every bar, under two moving voices that change on every beat. If
+//   period is nonzero, the bars repeat with that period.
+Score denseScore(std::mt19937& gen, unsigned int bars, unsigned int period = 0) {
+    std::uniform_int_distribution<int> root(0, 11);
+    std::uniform_int_distribution<int> step(0, 6);
+    const int scale[7]{0, 2, 4, 5, 7, 9, 11};
+    std::mt19937 start = gen;
+    Score score;
+    for (unsigned int bar = 0; bar < bars; bar++) {
+        if (period > 0 && bar % period == 0) gen = start;
+        int r = root(gen);
+        for (int offset : {0, 4, 7}) {
+            score.add(EPitch{static_cast<Pitch>((r + offset) % 12), 3}, 4, 4 * bar + 1);
+        }
+        for (unsigned int beat = 0; beat < 4; beat++) {
+            score.add(EPitch{static_cast<Pitch>((r + scale[step(gen)]) % 12), 4}, 1, 4 * bar + beat + 1);
+            score.add(EPitch{static_cast<Pitch>((r + scale[step(gen)]) % 12), 5}, 1, 4 * bar + beat + 1);
+        }
+    }
+    return score;
+}
+
+void benchHierarchy() {
+    std::mt19937 gen(2028);
+    Score score = denseScore(gen, 48);
+    const int runs = 3;
+
+    double full = time("hierarchy/full", [&]() { score.calculateFreqs(); }, runs);
+    std::cout << "calculateFreqs (192 dense beats): " << full << " us" << std::endl;
+    bool departed = false;
+    for (unsigned int band : {1u, 2u, 4u}) {
+        Hierarchy hierarchy;
+        hierarchy.band = band;
+        HierarchyReport report{};
+        double t = time("hierarchy/band-" + std::to_string(band), [&]() { report = score.calculateFreqs(Algo::Options{}, hierarchy); }, runs);
+        std::cout << "  hierarchical, band " << band << ": " << t << " us (" << full / t << "x), "
+                  << report.departedBeats << "/" << report.beats << " beats and " << report.departedNotes << "/"
+                  << report.notes << " notes depart from the coarse solution" << std::endl;
+        departed = departed || report.departedNotes > 0;
+    }
+    check(departed, "the fine pass can depart from the coarse solution");
+}
+
+// The number of file tasks of benchWorkers the calling thread is running
+thread_local unsigned int filesRunning = 0;
+
+void benchWorkers() {
+	// Files split into spans, as the tuner solves them: every file task waits
+	//   for its own spans, and must not run another file meanwhile
+    Workers workers{4};
+    const unsigned int files = 16;
+    std::atomic<unsigned int> deepest{0};
+    std::vector<double> fileTimes(files);
+    double t = time("workers/files", [&]() {
+        workers.forEach(files, [&](unsigned int k) {
+            auto start = steady_clock::now();
+            deepest = std::max(deepest.load(), ++filesRunning);
+            workers.forEach(2 + k % 3, [&](unsigned int) { std::this_thread::sleep_for(milliseconds(2)); });
+            filesRunning--;
+            fileTimes[k] = duration_cast<microseconds>(steady_clock::now() - start).count() / 1000.0;
+        });
+    }, 3);
+    check(deepest == 1, "a file task waiting for its spans runs no other file");
+    std::cout << "Workers (" << files << " files of 2 to 4 spans of 2 ms on 4 threads): " << t << " us, slowest file "
+              << *std::max_element(fileTimes.begin(), fileTimes.end()) << " ms" << std::endl;
+}
+
+void benchSolver() {
+    std::mt19937 gen(2029);
+    std::list<std::list<EPitch>> chords = randomSequence(gen, 200, 4);
+    std::vector<EPitch> pitches;
+    std::vector<unsigned int> offsets{0};
+    for (const std::list<EPitch>& chord : chords) {
+        pitches.insert(pitches.end(), chord.begin(), chord.end());
+        offsets.emplace_back(pitches.size());
+    }
+    ChordSequence seq{pitches.data(), offsets.data(), static_cast<unsigned int>(chords.size())};
+    const int runs = 5;
+
+    double cold = time("solver/cold", [&]() { Algo::getTunings(seq); }, runs);
+    std::cout << "getTunings (200 chords), new Solver every solve: " << cold << " us" << std::endl;
+
+    std::shared_ptr<Algo::SharedCache> shared = std::make_shared<Algo::SharedCache>();
+    Algo::Solver solver{Algo::Options{}, shared};
+    solver.getTunings(seq);
+    solver.publish();
+    double warm = time("solver/same-solver", [&]() { solver.getTunings(seq); }, runs);
+    const Algo::Stats& stats = solver.getStats();
+    std::cout << "  same Solver: " << warm << " us (" << cold / warm << "x), " << stats.hits << " hits and "
+              << stats.searches << " searches over " << stats.solves << " solves" << std::endl;
+
+    double fromShared = time("solver/shared-cache", [&]() { Algo::Solver{Algo::Options{}, shared}.getTunings(seq); }, runs);
+    std::cout << "  new Solver with a shared cache of " << shared->size() << " expansions: " << fromShared
+              << " us (" << cold / fromShared << "x)" << std::endl;
+}
+
+void benchRepeats() {
+    std::mt19937 gen(2030);
+    Score repeated = denseScore(gen, 48, 8);
+    Score distinct = denseScore(gen, 48);
+    const int runs = 3;
+
+    Algo::Stats stats;
+    double t = time("repeats/repeated", [&]() { stats = repeated.calculateFreqs(Algo::Options{}); }, runs);
+    double base = time("repeats/distinct", [&]() { distinct.calculateFreqs(Algo::Options{}); }, runs);
+    std::cout << "calculateFreqs (192 dense beats, 8-bar passage repeated 6 times): " << t << " us, "
+              << stats.replayed << "/" << stats.chords << " beats replayed from " << stats.passages
+              << " repeated passages; without repeats: " << base << " us" << std::endl;
+}
+
+void benchHeld() {
+    const int runs = 3;
+    for (unsigned int hold : {4u, 8u, 16u}) {
+        std::mt19937 gen(2031);
+        std::uniform_int_distribution<int> root(0, 11);
+        Score score;
+        std::list<std::list<EPitch>> beats;
+        for (unsigned int bar = 0; bar < 40; bar++) {
+            int r = root(gen);
+            std::list<EPitch> chord;
+            for (int offset : {0, 4, 7}) {
+                EPitch pitch{static_cast<Pitch>((r + offset) % 12), 3 + (r + offset) / 12};
+                score.add(pitch, hold, hold * bar + 1);
+                chord.emplace_back(pitch);
+            }
+            for (unsigned int beat = 0; beat < hold; beat++) beats.emplace_back(chord);
+        }
+
+        double perBeat = time("held/per-beat-" + std::to_string(hold), [&]() { Algo::getTunings(beats); }, runs);
+        double held = time("held/collapsed-" + std::to_string(hold), [&]() { score.calculateFreqs(); }, runs);
+        std::cout << "40 triads held for " << hold << " beats: getTunings with one chord per beat " << perBeat
+                  << " us, calculateFreqs with held chords collapsed " << held << " us (" << perBeat / held << "x)" << std::endl;
+    }
+}
+
+void benchStorage() {
+    const int runs = 3;
+    for (unsigned int length : {1u, 16u, 256u}) {
+        std::mt19937 gen(2038);
+        std::uniform_int_distribution<int> pitch(0, 11);
+        Score score;
+        long durations = 0;
+        double notes = time("storage/add-notes-" + std::to_string(length), [&]() {
+            score = Score{};
+            for (unsigned int voice = 0; voice < 4; voice++) {
+                for (unsigned int note = 0; note < 4096; note++) {
+                    score.add(EPitch{static_cast<Pitch>(pitch(gen)), 2 + static_cast<int>(voice)}, length, note * length + 1);
+                }
+            }
+            for (auto it = score.nbegin(); it != score.nend(); ++it) durations += (*it).duration;
+        }, runs);
+        long pitches = 0;
+        double beats = time("storage/iterate-beats-" + std::to_string(length), [&]() {
+            for (FreqSpan beat : score) pitches += beat.size();
+        }, runs);
+        std::cout << "16384 notes of " << length << " beats: add and iterate notes " << notes
+                  << " us, iterate " << score.getLength() << " beats " << beats << " us" << std::endl;
+    }
+
+	// Notes that last no ticks, that have negative fields or that would be
+	//   released past the last tick are ignored rather than wrapping around
+	//   the length of the score
+    Score score;
+    score.add(EPitch{Pitch::C, 4}, 2, 1).add(EPitch{Pitch::E, 4}, 0, 0).add(EPitch{Pitch::G, 4}, 0, 2);
+    score.add(EPitch{Pitch::G, 4}, UINT32_MAX, 2).add(Note{EPitchFreq{EPitch{Pitch::B, 4}, 0.0}, -1, 1});
+    score.add(Note{EPitchFreq{EPitch{Pitch::B, 4}, 0.0}, 1, -3}).add(Note{EPitchFreq{EPitch{Pitch::D, 4}, 0.0}, 0, 0});
+    unsigned int notes = 0;
+    for (auto it = score.nbegin(); it != score.nend(); ++it) notes++;
+    check(score.getLength() == 2 && notes == 1, "invalid notes changed a score (length " + std::to_string(score.getLength())
+          + ", " + std::to_string(notes) + " notes)");
+	// Ticks start at 1, so a note at tick 0 is ignored rather than merged
+	//   into the note after it
+    Score layered;
+    layered.add(EPitch{Pitch::C, 4}, 3, 0).add(EPitch{Pitch::E, 4}, 1, 1).add(EPitch{Pitch::G, 4}, 2, 2);
+    layered.add(Note{EPitchFreq{EPitch{Pitch::B, 4}, 0.0}, 1, 0});
+    std::string found;
+    for (auto it = layered.nbegin(); it != layered.nend(); ++it) found += std::to_string((*it).startBeat) + ":" + std::to_string((*it).duration) + " ";
+    check(found == "1:1 2:2 ", "notes at tick 0 changed a score (notes " + found + ")");
+}
+
+void benchResolution() {
+    const int runs = 3;
+    for (unsigned int resolution : {3u, 12u, 96u}) {
+        std::mt19937 gen(2039);
+        std::uniform_int_distribution<int> root(0, 11);
+        std::uniform_int_distribution<int> step(0, 6);
+        const int scale[7]{0, 2, 4, 5, 7, 9, 11};
+        Score score{resolution};
+        for (unsigned int bar = 0; bar < 12; bar++) {
+            int r = root(gen);
+            for (int offset : {0, 4, 7}) {
+                score.add(EPitch{static_cast<Pitch>((r + offset) % 12), 3}, 4 * resolution, 4 * bar * resolution + 1);
+            }
+            for (unsigned int note = 0; note < 12; note++) {
+                score.add(EPitch{static_cast<Pitch>((r + scale[step(gen)]) % 12), 4}, resolution / 3, (12 * bar + note) * resolution / 3 + 1);
+            }
+        }
+
+        Algo::Stats stats;
+        double t = time("resolution/calculateFreqs-" + std::to_string(resolution), [&]() { stats = score.calculateFreqs(Algo::Options{}); }, runs);
+        std::cout << "12 bars of triplets at " << resolution << " ticks per beat: calculateFreqs " << t << " us, "
+                  << stats.chords << " chords solved for " << score.getLength() << " ticks" << std::endl;
+    }
+}
+
+void benchFlat() {
+    std::mt19937 gen(2029);
+    std::list<std::list<EPitch>> chords = randomSequence(gen, 200, 4);
+    std::vector<EPitch> pitches;
+    std::vector<unsigned int> offsets{0};
+    for (const std::list<EPitch>& chord : chords) {
+        pitches.insert(pitches.end(), chord.begin(), chord.end());
+        offsets.emplace_back(pitches.size());
+    }
+    ChordSequence seq{pitches.data(), offsets.data(), static_cast<unsigned int>(chords.size())};
+    TuningSequence tunings = Algo::getTunings(seq)[0];
+    const int runs = 200;
+
+    std::size_t nestedCount = 0;
+    double nested = time("flat/nested", [&]() { nestedCount += tunings.getFreqs().size(); }, runs);
+    std::vector<EPitchFreq> freqs;
+    std::vector<unsigned int> freqOffsets;
+    double flat = time("flat/flat", [&]() { tunings.getFreqs(freqs, freqOffsets); }, runs);
+    std::cout << "getFreqs (200 chords): nested vectors " << nested << " us, into reused buffers " << flat
+              << " us (" << nested / flat << "x)" << std::endl;
+}
+void benchMidi() {
+    std::mt19937 gen(2042);
+    std::string midi = randomMidi(gen, 16, 1 << 16);
+    const char* file = "bench.mid";
+    std::FILE* out = std::fopen(file, "wb");
+    std::fwrite(midi.data(), 1, midi.size(), out);
+    std::fclose(out);
+    const int runs = 3;
+
+    Score score;
+    double fromFile = time("midi/read-file", [&]() { readMidi(file, score); }, runs);
+    double fromMemory = time("midi/read-memory", [&]() {
+        readMidi(reinterpret_cast<const unsigned char*>(midi.data()), midi.size(), score);
+    }, runs);
+    std::remove(file);
+    unsigned int notes = 0;
+    for (auto it = score.nbegin(); it != score.nend(); ++it) notes++;
+    double megabytes = midi.size() / 1e6;
+    std::cout << "readMidi (" << megabytes << " MB, " << notes << " notes): from file " << fromFile << " us ("
+              << megabytes / fromFile * 1e6 << " MB/s), from memory " << fromMemory << " us ("
+              << megabytes / fromMemory * 1e6 << " MB/s)" << std::endl;
+
+	// A file with an empty track solves to an empty score, which is written
+	//   through
+    const unsigned char empty[] = {'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 1, 0, 1, 1, 0xe0,
+                                   'M', 'T', 'r', 'k', 0, 0, 0, 4, 0, 0xff, 0x2f, 0};
+    Score silent;
+    check(readMidi(empty, sizeof(empty), silent) && silent.getLength() == 0, "an empty MIDI file reads as an empty score");
+    silent.calculateFreqs();
+    silent.calculateFreqs(Algo::Options{}, Hierarchy{});
+    check(writeMidi(file, silent) && readMidi(file, silent) && silent.getLength() == 0, "an empty score is written through");
+    std::remove(file);
+}
+void benchScoreText() {
+    std::mt19937 gen(2042);
+    std::string midi = randomMidi(gen, 16, 1 << 16);
+    Score score;
+    readMidi(reinterpret_cast<const unsigned char*>(midi.data()), midi.size(), score);
+    const char* file = "bench.score";
+    writeScore(file, score);
+    std::ostringstream contents;
+    contents << std::ifstream{file}.rdbuf();
+    std::string text = contents.str();
+    const int runs = 3;
+
+    double fromFile = time("scoretext/read-file", [&]() { readScore(file, score); }, runs);
+    double fromMemory = time("scoretext/read-memory", [&]() { readScore(text.data(), text.size(), score); }, runs);
+    std::remove(file);
+    unsigned int notes = 0;
+    for (auto it = score.nbegin(); it != score.nend(); ++it) notes++;
+    double megabytes = text.size() / 1e6;
+    std::cout << "readScore (" << megabytes << " MB, " << notes << " notes): from file " << fromFile << " us ("
+              << megabytes / fromFile * 1e6 << " MB/s), from memory " << fromMemory << " us ("
+              << megabytes / fromMemory * 1e6 << " MB/s)" << std::endl;
+
+	// An empty file is an empty score, which has nothing to solve
+    std::fclose(std::fopen(file, "wb"));
+    Score silent;
+    check(readScore(file, silent) && silent.getLength() == 0, "an empty .score file reads as an empty score");
+    silent.calculateFreqs();
+    silent.calculateFreqs(Algo::Options{}, Hierarchy{});
+    check(!(silent.nbegin() != silent.nend()), "an empty score solves to no notes");
+    std::remove(file);
+}
+
+void benchMidiOut() {
+    std::mt19937 gen(2043);
+    Score score = denseScore(gen, 48);
+    score.calculateFreqs(Algo::Options{});
+    const char* file = "bench.mid";
+    const int runs = 5;
+
+    for (Retuning retuning : {Retuning::TuningStandard, Retuning::PitchBend}) {
+        double t = time(std::string{"midiout/"} + (retuning == Retuning::TuningStandard ? "mts" : "bend"), [&]() { writeMidi(file, score, retuning); }, runs);
+        std::FILE* in = std::fopen(file, "rb");
+        std::fseek(in, 0, SEEK_END);
+        long size = std::ftell(in);
+        std::fclose(in);
+        std::cout << "writeMidi (192 dense beats) with " << (retuning == Retuning::TuningStandard ? "MTS" : "pitch bends")
+                  << ": " << t << " us, " << size << " bytes" << std::endl;
+    }
+    std::remove(file);
+}
+void benchTuningFile() {
+    std::mt19937 gen(2029);
+    std::list<std::list<EPitch>> chords = randomSequence(gen, 200, 4);
+    std::vector<EPitch> pitches;
+    std::vector<unsigned int> offsets{0};
+    for (const std::list<EPitch>& chord : chords) {
+        pitches.insert(pitches.end(), chord.begin(), chord.end());
+        offsets.emplace_back(pitches.size());
+    }
+    TuningSequence solved = Algo::getTunings(ChordSequence{pitches.data(), offsets.data(), static_cast<unsigned int>(chords.size())})[0];
+    TuningSequence tunings;
+    for (unsigned int k = 0; k < 5000; k++) {
+        for (const Tuning& tuning : solved) tunings.addTuning(tuning);
+    }
+    const char* file = "bench.dtsq";
+    const int runs = 3;
+
+    double save = time("tuningfile/save", [&]() { saveTunings(file, tunings); }, runs);
+    TuningFile result;
+    double open = time("tuningfile/open", [&]() { result.open(file); }, runs);
+    double sum = 0;
+    double read = time("tuningfile/read", [&]() {
+        for (unsigned int i = 0; i < result.size(); i++) {
+            for (EPitchFreq freq : result[i]) sum += freq.freq;
+        }
+    }, runs);
+    std::vector<EPitchFreq> freqs;
+    std::vector<unsigned int> freqOffsets;
+    double recompute = time("tuningfile/getFreqs", [&]() { tunings.getFreqs(freqs, freqOffsets); }, runs);
+    std::FILE* in = std::fopen(file, "rb");
+    std::fseek(in, 0, SEEK_END);
+    long size = std::ftell(in);
+    std::fclose(in);
+    unsigned int count = result.size();
+    result.close();
+    std::remove(file);
+    std::cout << "TuningFile (" << count << " chords, " << size << " bytes): save " << save
+              << " us, open " << open << " us, read every frequency " << read << " us; getFreqs " << recompute
+              << " us" << std::endl;
+}
+
+void benchDiskCache() {
+    std::mt19937 gen(2028);
+    Score score = denseScore(gen, 48);
+    const char* file = "bench.dtcc";
+    const int runs = 3;
+
+	// A first process solves with no cache file and merges its expansions
+	//   into one; later processes open the file and solve from it
+    double cold = time("diskcache/cold", [&]() { score.calculateFreqs(Algo::Options{}); }, runs);
+    std::shared_ptr<Algo::SharedCache> first = std::make_shared<Algo::SharedCache>();
+    score.calculateFreqs(Algo::Options{}, first);
+    unsigned long added = 0;
+    double merge = time("diskcache/merge", [&]() { std::remove(file); Algo::DiskCache::merge(file, *first, added); }, runs);
+
+    std::shared_ptr<Algo::DiskCache> disk = std::make_shared<Algo::DiskCache>();
+    double open = time("diskcache/open", [&]() { disk->open(file); }, runs);
+    Algo::Stats stats;
+    double warm = time("diskcache/warm", [&]() { stats = score.calculateFreqs(Algo::Options{}, std::make_shared<Algo::SharedCache>(Algo::Options{}, disk)); }, runs);
+    unsigned long entries = disk->size();
+    disk.reset();
+
+	// A damaged file whose table has no empty slot must not be probed
+	//   forever, and one whose sizes only match the file size once they
+	//   overflow must not be opened. The fields of the header are patched at
+	//   their offsets in diskcache.cc (56 bytes, with the slot count at 32 and
+	//   the word count at 48).
+    std::string bytes;
+    {
+        std::ifstream in{file, std::ios::binary};
+        bytes.assign(std::istreambuf_iterator<char>{in}, std::istreambuf_iterator<char>{});
+    }
+    auto patch = [&bytes](std::size_t at, uint64_t word) {
+        std::memcpy(&bytes[at], &word, 8);
+    };
+    auto write = [&](const std::string& contents) {
+        std::ofstream out{file, std::ios::binary | std::ios::trunc};
+        out.write(contents.data(), contents.size());
+    };
+    uint64_t slotCount;
+    std::memcpy(&slotCount, &bytes[32], 8);
+    for (uint64_t i = 0; i < slotCount; i++) patch(56 + 16 * i, 3);
+    write(bytes);
+    Algo::DiskCache full;
+    std::vector<std::pair<Tuning, int>> expansions;
+    check(full.open(file) && !full.find(Tuning{}.addNoteTuning(NoteTuning{EPitch{Pitch::C, 4}, Frac{1, 1}}), std::vector<EPitch>{EPitch{Pitch::E, 4}}, expansions),
+          "lookup in a cache file without an empty slot");
+    patch(32, 1ul << 62);
+    patch(48, 0);
+    write(bytes.substr(0, 56));
+    check(!Algo::DiskCache{}.open(file), "opened a cache file whose sizes overflow");
+
+    std::remove(file);
+    std::remove((std::string{file} + ".lock").c_str());
+    std::cout << "DiskCache (192 dense beats, " << entries << " entries): merge " << merge << " us, open " << open
+              << " us; calculateFreqs with no cache " << cold << " us, from the cache file " << warm << " us ("
+              << cold / warm << "x), " << stats.diskHits << "/" << stats.diskLookups << " lookups hit, "
+              << static_cast<double>(stats.diskNanoseconds) / std::max(stats.diskLookups, 1ul) << " ns per lookup"
+              << std::endl;
+}
+
+void benchCounters() {
+    if (!Algo::countersEnabled) {
+        std::cout << "Counters: not compiled in (make clean, then make bench COUNTERS=1)" << std::endl;
+        return;
+    }
+    for (Algo::Tier tier : {Algo::Tier::Exact, Algo::Tier::Pruned}) {
+        std::mt19937 gen(2047);
+        std::list<std::list<EPitch>> seq = randomSequence(gen, 100, 6);
+        std::vector<EPitch> pitches;
+        std::vector<unsigned int> offsets{0};
+        for (const std::list<EPitch>& chord : seq) {
+            pitches.insert(pitches.end(), chord.begin(), chord.end());
+            offsets.emplace_back(pitches.size());
+        }
+        Algo::Solver solver{Algo::Options{tier}};
+        double t = time(std::string{"counters/getTunings-"} + (tier == Algo::Tier::Exact ? "exact" : "pruned"), [&]() {
+            solver.getTunings(ChordSequence{pitches.data(), offsets.data(), static_cast<unsigned int>(seq.size())});
+        }, 1);
+        const Algo::Stats& stats = solver.getStats();
+        const Algo::Counters& counters = stats.counters;
+        std::cout << "Counters of getTunings (100 chords of 1-6 pitches, " << (tier == Algo::Tier::Exact ? "exact" : "pruned")
+                  << " tier): " << t << " us, " << counters.recursions << " recursions, " << counters.pairsExamined
+                  << " pairs examined, " << counters.pairsPruned << " pruned, " << counters.tunings
+                  << " tunings built, frontier " << static_cast<double>(counters.frontierTotal) / std::max(stats.chords, 1ul)
+                  << " on average and " << counters.frontierPeak << " at most, " << counters.ties << " ties, "
+                  << counters.reductions << " fractions reduced; search " << counters.searchNanoseconds / 1000
+                  << " us, steps " << counters.stepNanoseconds / 1000 << " us, backtracking "
+                  << counters.backtrackNanoseconds / 1000 << " us" << std::endl;
+    }
+}
+
+void benchTrace() {
+    const unsigned int scopes = 1 << 20;
+    const int runs = 3;
+    Trace::stop();
+    double off = time("trace/scope-off", [&]() {
+        for (unsigned int i = 0; i < scopes; i++) Trace::Scope scope{"bench"};
+    }, runs);
+    Trace::start();
+    double on = time("trace/scope-on", [&]() {
+        for (unsigned int i = 0; i < scopes; i++) Trace::Scope scope{"bench"};
+    }, runs);
+    Trace::stop();
+    const char* file = "bench.trace.json";
+    double dump = time("trace/dump", [&]() { Trace::dump(file); }, runs);
+    std::remove(file);
+    std::cout << "Trace::Scope: " << off * 1000 / scopes << " ns while not recording, " << on * 1000 / scopes
+              << " ns while recording; dump of " << Trace::capacity << " events " << dump << " us" << std::endl;
+}
+
+// The benchmarks, by the names they are selected with
+const std::vector<std::pair<std::string, void (*)()>> BENCHMARKS{
+    {"frac", benchFrac},
+    {"pairs", benchPairs},
+    {"values", benchValues},
+    {"progressions", benchProgressions},
+    {"sample", benchSample},
+    {"counters", benchCounters},
+    {"checkpoint", benchCheckpoint},
+    {"resume", benchResume},
+    {"chromatic", benchChromatic},
+    {"decomposition", benchDecomposition},
+    {"profiles", benchProfiles},
+    {"tiers", benchTiers},
+    {"hierarchy", benchHierarchy},
+    {"workers", benchWorkers},
+    {"solver", benchSolver},
+    {"repeats", benchRepeats},
+    {"held", benchHeld},
+    {"storage", benchStorage},
+    {"resolution", benchResolution},
+    {"flat", benchFlat},
+    {"midi", benchMidi},
+    {"midiout", benchMidiOut},
+    {"scoretext", benchScoreText},
+    {"tuningfile", benchTuningFile},
+    {"diskcache", benchDiskCache},
+    {"trace", benchTrace}
+};
+
+void usage() {
+    std::cerr << "usage: bench [options] [benchmark...]\n"
+              << "Runs the given benchmarks (default: all of them).\n"
+              << "  --list          list the benchmarks\n"
+              << "  --json FILE     write the results to FILE as JSON\n"
+              << "  --compare FILE  compare the results with those in FILE, written by --json,\n"
+              << "                  and fail if any got slower by more than the tolerance\n"
+              << "  --tolerance P   the tolerance of --compare in percent (default: 10)\n"
+              << "Fails if a check made by a benchmark fails." << std::endl;
+}
+
+bool writeResults(const std::string& file) {
+    std::ofstream out{file};
+    out << "{\n  \"unit\": \"us\",\n  \"results\": [";
+    for (std::size_t i = 0; i < results.size(); i++) {
+        out << (i == 0 ? "\n" : ",\n") << "    {\"name\": \"" << results[i].first << "\", \"time\": " << results[i].second << "}";
+    }
+    out << "\n  ]\n}\n";
+    out.flush();
+    return static_cast<bool>(out);
+}
+
+// Reads the results written by writeResults, which have one result per line
+bool readResults(const std::string& file, std::map<std::string, double>& read) {
+    std::ifstream in{file};
+    if (!in) return false;
+    for (std::string line; std::getline(in, line);) {
+        std::size_t name = line.find("{\"name\": \"");
+        if (name == std::string::npos) continue;
+        name += 10;
+        std::size_t nameEnd = line.find('"', name);
+        std::size_t time = line.find("\"time\": ", nameEnd);
+        if (nameEnd == std::string::npos || time == std::string::npos) return false;
+        read[line.substr(name, nameEnd - name)] = std::atof(line.c_str() + time + 8);
+    }
+    return true;
+}
+
+// Prints how every result changed from the baseline, and returns the number
+//   of results that got slower by more than the given tolerance in percent
+unsigned int compareResults(const std::map<std::string, double>& baseline, double tolerance) {
+    unsigned int regressions = 0;
+    std::cout << "\ncompared with the baseline:" << std::endl;
+    for (const std::pair<std::string, double>& result : results) {
+        auto base = baseline.find(result.first);
+        if (base == baseline.end() || base->second <= 0) {
+            std::cout << "  " << result.first << ": " << result.second << " us (new)" << std::endl;
+            continue;
+        }
+        double change = (result.second - base->second) * 100 / base->second;
+        bool regressed = change > tolerance;
+        if (regressed) regressions++;
+        std::cout << "  " << result.first << ": " << base->second << " -> " << result.second << " us ("
+                  << (change >= 0 ? "+" : "") << change << "%)" << (regressed ? "  REGRESSION" : "") << std::endl;
+    }
+    std::cout << regressions << " of " << results.size() << " results regressed by more than " << tolerance << "%" << std::endl;
+    return regressions;
+}
+
+int main(int argc, char* argv[]) {
+    std::string json, compare;
+    double tolerance = 10;
+    std::vector<std::string> selected;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--list") {
+            for (auto& benchmark : BENCHMARKS) std::cout << benchmark.first << std::endl;
+            return 0;
+        } else if (arg == "--json" && hasValue) {
+            json = argv[++i];
+        } else if (arg == "--compare" && hasValue) {
+            compare = argv[++i];
+        } else if (arg == "--tolerance" && hasValue) {
+            tolerance = std::atof(argv[++i]);
+        } else if (arg.size() > 1 && arg[0] == '-') {
+            usage();
+            return 2;
+        } else {
+            selected.emplace_back(arg);
+        }
+    }
+    for (const std::string& name : selected) {
+        auto found = std::find_if(BENCHMARKS.begin(), BENCHMARKS.end(), [&](auto& benchmark) { return benchmark.first == name; });
+        if (found == BENCHMARKS.end()) {
+            std::cerr << "unknown benchmark " << name << std::endl;
+            return 2;
+        }
+    }
+    std::map<std::string, double> baseline;
+    if (!compare.empty() && !readResults(compare, baseline)) {
+        std::cerr << "cannot read " << compare << std::endl;
+        return 2;
+    }
+
+    for (auto& benchmark : BENCHMARKS) {
+        if (selected.empty() || std::find(selected.begin(), selected.end(), benchmark.first) != selected.end()) benchmark.second();
+    }
+
+    if (!json.empty() && !writeResults(json)) {
+        std::cerr << "cannot write " << json << std::endl;
+        return 2;
+    }
+    if (failures > 0) std::cout << failures << " checks failed" << std::endl;
+    if (!compare.empty() && compareResults(baseline, tolerance) > 0) return 1;
+    return failures > 0 ? 1 : 0;
+}
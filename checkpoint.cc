@@ -0,0 +1,373 @@
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <set>
+#include <utility>
+#include <filesystem>
+
+#include "frac.h"
+#include "pitch.h"
+#include "tunings.h"
+#include "pool.h"
+#include "checkpoint.h"
+
+const char MAGIC[4] = {'D', 'T', 'C', 'K'};
+const unsigned char VERSION = 1;
+const long HEADER_SIZE = 13;
+
+///////////////////////////////////////////////////////////////
+// Encoding helpers
+
+static void putVarint(std::string& out, unsigned long n) {
+    while (n >= 0x80) {
+        out.push_back(static_cast<char>((n & 0x7f) | 0x80));
+        n >>= 7;
+    }
+    out.push_back(static_cast<char>(n));
+}
+
+static void putSigned(std::string& out, long n) {
+    putVarint(out, (static_cast<unsigned long>(n) << 1) ^ static_cast<unsigned long>(n >> 63));
+}
+
+static void putFixed(std::string& out, unsigned long n, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        out.push_back(static_cast<char>((n >> (8 * i)) & 0xff));
+    }
+}
+
+static uint32_t checksum(const std::string& data) {
+    uint32_t h = 2166136261u;
+    for (char c : data) {
+        h = (h ^ static_cast<unsigned char>(c)) * 16777619u;
+    }
+    return h;
+}
+
+struct Reader {
+	// Cursor over a buffer that has already been checksummed; reads past the
+	//   end set the failure flag instead of overrunning
+    const std::string& data;
+    std::size_t pos;
+    bool failed;
+
+    unsigned long varint() {
+        unsigned long n = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (pos >= data.size()) break;
+            unsigned char c = data[pos++];
+            n |= static_cast<unsigned long>(c & 0x7f) << shift;
+            if (!(c & 0x80)) return n;
+        }
+        failed = true;
+        return 0;
+    }
+
+    long signedVarint() {
+        unsigned long n = varint();
+        return static_cast<long>(n >> 1) ^ -static_cast<long>(n & 1);
+    }
+
+    unsigned long fixed(int bytes) {
+        unsigned long n = 0;
+        if (pos + bytes > data.size()) {
+            failed = true;
+            return 0;
+        }
+        for (int i = 0; i < bytes; i++) {
+            n |= static_cast<unsigned long>(static_cast<unsigned char>(data[pos++])) << (8 * i);
+        }
+        return n;
+    }
+};
+
+static void putTuning(std::string& out, const Tuning& tuning) {
+    unsigned long n = 0;
+    for (auto it = tuning.begin(); it != tuning.end(); ++it) n++;
+    putVarint(out, n);
+    for (const NoteTuning& nt : tuning) {
+        out.push_back(static_cast<char>(nt.pitch.pitch));
+        putSigned(out, nt.pitch.octave);
+        putVarint(out, nt.tuning.p);
+        putVarint(out, nt.tuning.q);
+    }
+}
+
+static Tuning getTuning(Reader& in) {
+    Tuning tuning;
+    unsigned long n = in.varint();
+    for (unsigned long i = 0; i < n && !in.failed; i++) {
+        Pitch pitch = static_cast<Pitch>(in.fixed(1) % 12);
+        int octave = in.signedVarint();
+        unsigned long p = in.varint();
+        unsigned long q = in.varint();
+        if (p == 0 || q == 0) {
+            in.failed = true;
+            break;
+        }
+        tuning.addNoteTuning(NoteTuning{EPitch{pitch, octave}, Frac{p, q}});
+    }
+    return tuning;
+}
+
+///////////////////////////////////////////////////////////////
+
+Checkpoint::Checkpoint(const std::string& file, unsigned long fingerprint, unsigned int interval):
+    file{file}, fingerprint{fingerprint}, interval{interval}, pending{0}, out{nullptr}, savedStart{0}, savedSteps{0} {}
+
+Checkpoint::~Checkpoint() {
+    if (out) std::fclose(out);
+}
+
+bool Checkpoint::open(long length) {
+    if (out) std::fclose(out);
+    out = nullptr;
+
+    if (length > 0) {
+        std::error_code ec;
+        std::filesystem::resize_file(file, length, ec);
+        if (!ec) out = std::fopen(file.c_str(), "ab");
+        if (out) return true;
+    }
+
+    savedStart = 0;
+    savedSteps = 0;
+
+    out = std::fopen(file.c_str(), "wb");
+    if (!out) return false;
+    std::string header{MAGIC, MAGIC + 4};
+    header.push_back(static_cast<char>(VERSION));
+    putFixed(header, fingerprint, 8);
+    std::fwrite(header.data(), 1, header.size(), out);
+    std::fflush(out);
+    return true;
+}
+
+// Returns every tuning that some entry of backMap was reached from
+static std::set<uint32_t> predsOf(const std::unordered_map<uint32_t, std::pair<std::vector<uint32_t>, int>>& backMap) {
+    std::set<uint32_t> preds;
+    for (auto& entry : backMap) {
+        preds.insert(entry.second.first.begin(), entry.second.first.end());
+    }
+    return preds;
+}
+
+bool Checkpoint::load(SolveState& state, TuningPool& pool) {
+    std::string data;
+    if (std::FILE* in = std::fopen(file.c_str(), "rb")) {
+        char buffer[65536];
+        std::size_t n;
+        while ((n = std::fread(buffer, 1, sizeof(buffer), in)) > 0) {
+            data.append(buffer, n);
+        }
+        std::fclose(in);
+    }
+
+    Reader header{data, 0, false};
+    if (data.size() < HEADER_SIZE || data.compare(0, 4, MAGIC, 4) != 0 || data[4] != VERSION) {
+        open(0);
+        return false;
+    }
+    header.pos = 5;
+    if (header.fixed(8) != fingerprint) {
+        open(0);
+        return false;
+    }
+
+    SolveState restored{0, -1, {}, {}, {}};
+    bool any = false;
+    std::size_t good = HEADER_SIZE;
+
+	// The keys of every restored back-pointer map, in order, so that
+	//   back-pointers can be resolved by index
+    std::vector<std::vector<uint32_t>> keys;
+
+    while (good + 8 <= data.size()) {
+        Reader frame{data, good, false};
+        std::size_t length = frame.fixed(4);
+        uint32_t sum = frame.fixed(4);
+        if (good + 8 + length > data.size()) break;
+        std::string payload = data.substr(good + 8, length);
+        if (checksum(payload) != sum) break;
+
+        Reader in{payload, 0, false};
+        SolveState next{0, -1, {}, {}, restored.backMaps};
+        std::vector<std::vector<uint32_t>> nextKeys{keys};
+
+        next.start = in.varint();
+        next.bestValue = in.signedVarint();
+        unsigned long numBest = in.varint();
+        for (unsigned long i = 0; i < numBest && !in.failed; i++) {
+            TuningSequence ts;
+            unsigned long len = in.varint();
+            for (unsigned long j = 0; j < len && !in.failed; j++) {
+                ts.addTuning(getTuning(in));
+            }
+            next.best.emplace_back(ts);
+        }
+
+        unsigned long base = in.varint();
+        unsigned long count = in.varint();
+        if (base > next.backMaps.size()) {
+            in.failed = true;
+        } else {
+            next.backMaps.resize(base);
+            nextKeys.resize(base);
+        }
+        for (unsigned long i = 0; i < count && !in.failed; i++) {
+            std::unordered_map<uint32_t, std::pair<std::vector<uint32_t>, int>> backMap;
+            std::vector<uint32_t> backKeys;
+            const std::vector<uint32_t>* prevKeys = nextKeys.empty() ? nullptr : &nextKeys.back();
+            unsigned long size = in.varint();
+            for (unsigned long j = 0; j < size && !in.failed; j++) {
+                uint32_t key = pool.intern(getTuning(in));
+                int value = in.signedVarint();
+                std::vector<uint32_t> preds;
+                unsigned long numPreds = in.varint();
+                for (unsigned long k = 0; k < numPreds && !in.failed; k++) {
+                    if (!prevKeys) {
+                        preds.emplace_back(pool.intern(getTuning(in)));
+                    } else {
+                        unsigned long index = in.varint();
+                        if (index < prevKeys->size()) preds.emplace_back((*prevKeys)[index]);
+                        else in.failed = true;
+                    }
+                }
+                backMap.emplace(key, std::pair<std::vector<uint32_t>, int>{preds, value});
+                backKeys.emplace_back(key);
+            }
+            next.backMaps.emplace_back(std::move(backMap));
+            nextKeys.emplace_back(std::move(backKeys));
+        }
+
+        unsigned long frontierSize = in.varint();
+        for (unsigned long i = 0; i < frontierSize && !in.failed; i++) {
+            int value = in.signedVarint();
+            unsigned long index = in.varint();
+            if (index == 0) {
+                next.frontier.insert(next.frontier.end(), std::pair<int, uint32_t>{value, pool.intern(getTuning(in))});
+            } else if (!nextKeys.empty() && index <= nextKeys.back().size()) {
+                next.frontier.insert(next.frontier.end(), std::pair<int, uint32_t>{value, nextKeys.back()[index - 1]});
+            } else {
+                in.failed = true;
+            }
+        }
+
+        if (in.failed || in.pos != payload.size()) break;
+
+        restored = std::move(next);
+        keys = std::move(nextKeys);
+        any = true;
+        good += 8 + length;
+    }
+
+    if (!any) {
+        open(0);
+        return false;
+    }
+
+    savedStart = restored.start;
+    savedSteps = restored.backMaps.size();
+    state = std::move(restored);
+    open(good);
+    return true;
+}
+
+void Checkpoint::save(const SolveState& state, const TuningPool& pool) {
+    if (!out && !open(0)) return;
+
+	// Only the last back-pointer map can contain tunings that are not reached
+	//   by any later chord, so every earlier map is written with just the
+	//   tunings that the following map points back to. The last map is
+	//   written in full, and rewritten by the next save once it is no longer
+	//   the last.
+    unsigned long base = 0;
+    if (state.start == savedStart && savedSteps > 0 && state.backMaps.size() >= savedSteps) {
+        base = savedSteps - 1;
+    }
+
+    std::string payload;
+    putVarint(payload, state.start);
+    putSigned(payload, state.bestValue);
+    putVarint(payload, state.best.size());
+    for (const TuningSequence& ts : state.best) {
+        unsigned long len = 0;
+        for (auto it = ts.begin(); it != ts.end(); ++it) len++;
+        putVarint(payload, len);
+        for (const Tuning& t : ts) putTuning(payload, t);
+    }
+
+    putVarint(payload, base);
+    putVarint(payload, state.backMaps.size() - base);
+
+	// The map before base was written by an earlier save with just the keys
+	//   returned by predsOf for the map at base, in that order
+    std::unordered_map<uint32_t, unsigned long> prevIndices;
+    if (base > 0) {
+        unsigned long n = 0;
+        for (uint32_t t : predsOf(state.backMaps[base])) prevIndices.emplace(t, n++);
+    }
+
+    for (unsigned long i = base; i < state.backMaps.size(); i++) {
+        const std::unordered_map<uint32_t, std::pair<std::vector<uint32_t>, int>>& backMap = state.backMaps[i];
+        bool last = (i + 1 == state.backMaps.size());
+
+        std::vector<uint32_t> written;
+        if (last) {
+            for (auto& entry : backMap) written.emplace_back(entry.first);
+        } else {
+            for (uint32_t t : predsOf(state.backMaps[i + 1])) written.emplace_back(t);
+        }
+
+        std::unordered_map<uint32_t, unsigned long> indices;
+        putVarint(payload, written.size());
+        for (uint32_t key : written) {
+            const std::pair<std::vector<uint32_t>, int>& entry = backMap.at(key);
+            indices.emplace(key, indices.size());
+            putTuning(payload, pool.get(key));
+            putSigned(payload, entry.second);
+            putVarint(payload, entry.first.size());
+            for (uint32_t pred : entry.first) {
+                if (i == 0) putTuning(payload, pool.get(pred));
+                else putVarint(payload, prevIndices[pred]);
+            }
+        }
+        prevIndices = std::move(indices);
+    }
+
+    putVarint(payload, state.frontier.size());
+    for (auto& entry : state.frontier) {
+        putSigned(payload, entry.first);
+        auto find = prevIndices.find(entry.second);
+        if (find == prevIndices.end()) {
+            putVarint(payload, 0);
+            putTuning(payload, pool.get(entry.second));
+        } else {
+            putVarint(payload, find->second + 1);
+        }
+    }
+
+    std::string frame;
+    putFixed(frame, payload.size(), 4);
+    putFixed(frame, checksum(payload), 4);
+    std::fwrite(frame.data(), 1, frame.size(), out);
+    std::fwrite(payload.data(), 1, payload.size(), out);
+    std::fflush(out);
+
+    savedStart = state.start;
+    savedSteps = state.backMaps.size();
+    pending = 0;
+}
+
+void Checkpoint::tick(const SolveState& state, const TuningPool& pool) {
+    if (interval > 0 && ++pending >= interval) save(state, pool);
+}
+
+void Checkpoint::finish() {
+    if (out) std::fclose(out);
+    out = nullptr;
+    std::remove(file.c_str());
+}
@@ -0,0 +1,87 @@
+#ifndef _CHECKPOINT_H_
+#define _CHECKPOINT_H_
+
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <utility>
+
+#include "tunings.h"
+#include "pool.h"
+
+struct SolveState {
+	// Struct that stores the progress of a call to Algo::getTunings: every
+	//   start tuning before start has been solved completely, and the best
+	//   sequences found from them (with value bestValue) are stored in best.
+	//   The start tuning at index start is being solved, and has consumed
+	//   backMaps.size() chords so far.
+    unsigned int start;
+    int bestValue;
+    std::vector<TuningSequence> best;
+
+	// The tunings below are stored as IDs in the TuningPool that the state
+	//   is solved with.
+
+	// The current tunings of the start tuning being solved, mapped from their
+	//   values
+    std::multimap<int, uint32_t> frontier;
+
+	// One back-pointer map per consumed chord, mapping every tuning reached
+	//   at that chord to its best value and the tunings it was reached from
+    std::vector<std::unordered_map<uint32_t, std::pair<std::vector<uint32_t>, int>>> backMaps;
+};
+
+class Checkpoint {
+	// Class that periodically writes a SolveState to a binary file so that a
+	//   preempted solve can be resumed. The file is a journal: each save appends
+	//   only the back-pointer maps consumed since the previous save, along with
+	//   the current frontier, so the total amount written stays linear in the
+	//   length of the sequence. Back-pointers are written as indices into the
+	//   keys of the previous chord's map, and integers are variable-length
+	//   encoded.
+	// A save that is interrupted partway leaves a truncated record at the end
+	//   of the file, which is detected and ignored when loading.
+    private:
+        std::string file;
+        unsigned long fingerprint;
+        unsigned int interval;
+        unsigned int pending;
+
+        std::FILE* out;
+        unsigned int savedStart;
+        unsigned long savedSteps;
+
+        bool open(long length);
+
+    public:
+		// Create a checkpoint that uses the given file, and saves after every
+		//   interval chords consumed. The fingerprint identifies the sequence
+		//   being solved; a file written for a different fingerprint is
+		//   never loaded.
+        Checkpoint(const std::string& file, unsigned long fingerprint, unsigned int interval);
+
+		// Close the file without removing it
+        ~Checkpoint();
+
+		// Restore the state from the last complete save in the file, if any,
+		//   adding its tunings to the given pool. Returns true if a state was
+		//   restored, and false otherwise (in which case the state is left
+		//   unmodified and the file is restarted).
+        bool load(SolveState&, TuningPool&);
+
+		// Append the given state, whose tunings are in the given pool, to the
+		//   file
+        void save(const SolveState&, const TuningPool&);
+
+		// Note that one more chord has been consumed, saving the given state
+		//   if interval chords have been consumed since the last save
+        void tick(const SolveState&, const TuningPool&);
+
+		// Remove the file. Should be called once the solve has finished.
+        void finish();
+};
+
+#endif
@@ -11,6 +11,8 @@
 #include "pitch.h"
 #include "tunings.h"
 #include "algo.h"
+#include "solver.h"
+#include "trace.h"
 
 #include "controller.h"
 #include "receiver.h"
@@ -26,6 +28,9 @@ struct ControllerImpl {
     Tuning echo;
     std::list<EPitch> currNotes;
 	std::vector<EPitchFreq> freqs;
+
+	// Solver for the notes added, which keeps its cache between notes
+	Algo::Solver solver;
 	
 	double relFreq;
 	
@@ -49,7 +54,7 @@ struct ControllerImpl {
 			return;
 		}
 		
-		freqs = curr.getEPitchFreqs(relFreq);
+		curr.getEPitchFreqs(relFreq, freqs);
 	}
 	
 	void notifyReceiverAdd() {
@@ -72,11 +77,13 @@ struct ControllerImpl {
 		currMutex.unlock();
 		
 		computeFreqs();
+		Trace::Scope trace{"Receiver::notify"};
 		receiver->notify(freqs);
 	}
 	
 	void notifyReceiverRemove() {
 		computeFreqs();
+		Trace::Scope trace{"Receiver::notify"};
 		receiver->notify(freqs);
 	}
 
@@ -84,13 +91,26 @@ struct ControllerImpl {
     // Helpers for Controller::add
 
     void add(const EPitch& ep) {
+		Trace::Scope trace{"Controller::add"};
+		
+		// A full Solver is swapped out here rather than cleared under the
+		//   locks, and freed once they are released
+		std::unique_ptr<Algo::Solver> full;
 		
+		Trace::Scope waiting{"add: wait for locks"};
 		currMutex.lock();
 		std::unique_lock<std::mutex> echoLock(echoMutex);
 		std::unique_lock<std::mutex> noteLock(noteMutex);
+		waiting.end();
 		
 		currNotes.emplace_back(ep);
-		curr = Algo::getBestValues(echo, currNotes)[0];
+		if (solver.isFull()) {
+			full = std::make_unique<Algo::Solver>(solver.getOptions());
+			std::swap(solver, *full);
+		}
+		Trace::Scope solving{"getBestValues"};
+		curr = solver.getBestValues(echo, currNotes)[0];
+		solving.end();
 		
 		currMutex.unlock();
 		notifyReceiverAdd();
@@ -100,6 +120,7 @@ struct ControllerImpl {
     // Helpers for Controller::remove
 
     void refreshWorker() {
+        Trace::nameThread("Controller refresh");
         while (true) {
             auto now = high_resolution_clock::now();
             if (now.time_since_epoch() > nextRefresh.load()) {
@@ -109,8 +130,11 @@ struct ControllerImpl {
     }
 
     void removeNote(const EPitch& ep) {
+		Trace::Scope trace{"Controller::removeNote"};
+		Trace::Scope waiting{"removeNote: wait for locks"};
         currMutex.lock();
 		noteMutex.lock();
+		waiting.end();
 		auto it = std::find(currNotes.begin(), currNotes.end(), ep);
 		bool removed = it != currNotes.end();
 		NoteTuning removedNote{EPitch{}, Frac{0, 1}};
@@ -122,8 +146,10 @@ struct ControllerImpl {
 		noteMutex.unlock();
         if (removed) {
             auto removeAt = duration_cast<milliseconds>((high_resolution_clock::now() + refresh).time_since_epoch());
+			Trace::Scope echoWaiting{"removeNote: wait for echo locks"};
             std::unique_lock<std::mutex> echoQueueLock(echoQueueMutex);
 			std::unique_lock<std::mutex> echoLock(echoMutex);
+			echoWaiting.end();
             echoQueue.emplace_back(std::pair<EPitch, milliseconds>{ep, removeAt});
 			echo.addNoteTuning(removedNote);
             if (echoQueue.size() == 1) {
@@ -135,8 +161,11 @@ struct ControllerImpl {
     } 
 
     void updateEcho() {
+        Trace::Scope trace{"updateEcho"};
+        Trace::Scope waiting{"updateEcho: wait for locks"};
         std::unique_lock<std::mutex> echoLock(echoMutex);
         std::unique_lock<std::mutex> echoQueueLock(echoQueueMutex);
+        waiting.end();
         std::pair<EPitch, milliseconds> removed = echoQueue.front();
 
         echoQueue.pop_front();
@@ -174,6 +203,19 @@ void Controller::setRefresh(int n) {
     imp->refresh = milliseconds(n);
 }
 
+Algo::Options Controller::getOptions() const {
+    std::unique_lock<std::mutex> noteLock(imp->noteMutex);
+    return imp->solver.getOptions();
+}
+
+void Controller::setOptions(const Algo::Options& options) {
+	// The old Solver ends up in solver, which is freed after the lock is
+	//   released
+    Algo::Solver solver{options};
+    std::unique_lock<std::mutex> noteLock(imp->noteMutex);
+    std::swap(imp->solver, solver);
+}
+
 void Controller::setReceiver(Receiver* receiver) {
 	imp->receiver = receiver;
 }
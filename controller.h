@@ -7,6 +7,10 @@ class EPitch;
 class Receiver;
 struct ControllerImpl;
 
+namespace Algo {
+    struct Options;
+}
+
 class Controller {
 	// Class that receives add and remove pitch messages from an Input object,
 	//   computes new frequencies, and relays those frequencies as messages to
@@ -35,6 +39,15 @@ class Controller {
 		//   note's frequency is calculated only based on itself (and the notes
 		//   played within the refresh span of the new note, and so on).
         void setRefresh(int);
+
+		// Get the solver options used to calculate frequencies
+        Algo::Options getOptions() const;
+
+		// Set the solver options used to calculate frequencies (see
+		//   Algo::Options). The options take effect from the next note added.
+		//   A faster tier keeps the delay before the receiver is notified short
+		//   when many notes are held, at the cost of the quality of the tuning.
+        void setOptions(const Algo::Options&);
 		
 		// Set the receiver that is to receive messages from the controller.
 		//   The receiver's notify(std::vector<EPitchFreq>) method will be called
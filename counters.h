@@ -0,0 +1,100 @@
+#ifndef _COUNTERS_H_
+#define _COUNTERS_H_
+
+#include <chrono>
+
+namespace Algo {
+
+struct Counters {
+	// Struct that packages the instrumentation counters of a Solver (see
+	//   Stats), which tell where the time of a slow solve went: the steps of
+	//   the recursive search of getValuesRec, the pairs of pitches it
+	//   examined to branch on and how many of those were pruned (by the
+	//   threshold of the Pruned tier, or because an earlier branch already
+	//   tuned the pair in its ideal ratio), the tunings built by the search
+	//   or copied from a cache, the sizes of the frontier entering every step
+	//   of a sequence solve (summed, and the largest), the back-pointers kept
+	//   for tunings reached with the same value from several others, and the
+	//   fractions reduced to lowest terms, and the chords joined from their
+	//   components (see Options::decompose) or that fell back to a search of
+	//   the whole chord since Exact mode could not prove the join. The
+	//   times, in nanoseconds, are those of the searches, of the steps of
+	//   sequence solves (including their searches) and of backtracking
+	//   through the steps.
+	// The counters are only gathered when the project is compiled with
+	//   DATATUNE_COUNTERS defined (make COUNTERS=1). Otherwise the code that
+	//   gathers them compiles to nothing, and they stay 0.
+    unsigned long recursions = 0;
+    unsigned long pairsExamined = 0;
+    unsigned long pairsPruned = 0;
+    unsigned long tunings = 0;
+    unsigned long frontierTotal = 0;
+    unsigned long frontierPeak = 0;
+    unsigned long ties = 0;
+    unsigned long reductions = 0;
+    unsigned long decompositions = 0;
+    unsigned long decompositionFallbacks = 0;
+    unsigned long searchNanoseconds = 0;
+    unsigned long stepNanoseconds = 0;
+    unsigned long backtrackNanoseconds = 0;
+};
+
+#if defined(DATATUNE_COUNTERS)
+
+const bool countersEnabled = true;
+
+// The counters of the solve running on this thread, or null if there is none
+extern thread_local Counters* counting;
+
+class CountingScope {
+	// Class that directs the counters of this thread to the given counters for
+	//   as long as it lives, so that solves can nest
+    private:
+        Counters* previous;
+
+    public:
+        explicit CountingScope(Counters* counters): previous{counting} {
+            counting = counters;
+        }
+
+        ~CountingScope() {
+            counting = previous;
+        }
+};
+
+class CountingTimer {
+	// Class that adds the time it lives to a counter of the current solve
+    private:
+        unsigned long Counters::* field;
+        std::chrono::steady_clock::time_point start;
+
+    public:
+        explicit CountingTimer(unsigned long Counters::* field): field{field}, start{std::chrono::steady_clock::now()} {}
+
+        ~CountingTimer() {
+            if (counting) {
+                counting->*field += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+            }
+        }
+};
+
+#define COUNT(field, n) do { if (Algo::counting) Algo::counting->field += (n); } while (0)
+#define COUNT_PEAK(field, n) do { if (Algo::counting && Algo::counting->field < static_cast<unsigned long>(n)) Algo::counting->field = (n); } while (0)
+#define COUNT_TIME(field) Algo::CountingTimer countingTimer{&Algo::Counters::field}
+#define COUNT_INTO(counters) Algo::CountingScope countingScope{counters}
+
+#else
+
+const bool countersEnabled = false;
+
+// The counts are not evaluated, but still refer to what they count
+#define COUNT(field, n) do { (void)sizeof(n); } while (0)
+#define COUNT_PEAK(field, n) do { (void)sizeof(n); } while (0)
+#define COUNT_TIME(field) do {} while (0)
+#define COUNT_INTO(counters) do {} while (0)
+
+#endif
+
+}
+
+#endif
@@ -0,0 +1,277 @@
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <map>
+#include <utility>
+#include <filesystem>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+#include "frac.h"
+#include "pitch.h"
+#include "tunings.h"
+#include "mapped.h"
+#include "algo.h"
+#include "solver.h"
+#include "diskcache.h"
+
+const char CACHE_MAGIC[4] = {'D', 'T', 'C', 'C'};
+const uint32_t CACHE_ORDER_MARK = 0x01020304;
+
+struct CacheHeader {
+	// The header at the start of a cache file: the tier, decomposition and
+	//   threshold of the Solvers it was written from, and the sizes of the
+	//   slots and the entries that follow it. Slot i is the pair of words 2i
+	//   and 2i + 1 of the slots: the hash of its entry (with the lowest bit
+	//   set, so that 0 marks an empty slot), and where its entry starts in the
+	//   entry words.
+    char magic[4];
+    uint32_t version;
+    uint32_t orderMark;
+    uint32_t tier;
+    uint32_t decompose;
+    int64_t threshold;
+    uint64_t slotCount;
+    uint64_t entries;
+    uint64_t wordCount;
+};
+
+///////////////////////////////////////////////////////////////
+// Entry encoding
+//
+// An entry is a sequence of 64-bit words: its key, which is the number of
+//   pitches of the tuning and of the chord, the tuning (three words per pitch:
+//   the pitch, and the numerator and the denominator of its ratio) and the
+//   chord (one word per pitch), followed by the number of expansions and every
+//   expansion: its number of pitches, its value, and its tuning.
+
+static uint64_t pitchWord(const EPitch& pitch) {
+    return static_cast<uint32_t>(pitch.pitch) | (static_cast<uint64_t>(static_cast<uint32_t>(pitch.octave)) << 32);
+}
+
+static EPitch wordPitch(uint64_t word) {
+    return EPitch{static_cast<Pitch>(static_cast<uint32_t>(word)), static_cast<int>(static_cast<uint32_t>(word >> 32))};
+}
+
+static void putTuning(std::vector<uint64_t>& out, const Tuning& tuning) {
+    for (const NoteTuning& nt : tuning) {
+        out.emplace_back(pitchWord(nt.pitch));
+        out.emplace_back(nt.tuning.p);
+        out.emplace_back(nt.tuning.q);
+    }
+}
+
+static void putKey(std::vector<uint64_t>& out, const Tuning& normal, const std::vector<EPitch>& chord) {
+    unsigned int pitches = 0;
+    for (auto it = normal.begin(); it != normal.end(); ++it) pitches++;
+    out.emplace_back(pitches);
+    out.emplace_back(chord.size());
+    putTuning(out, normal);
+    for (const EPitch& pitch : chord) out.emplace_back(pitchWord(pitch));
+}
+
+static void putExpansions(std::vector<uint64_t>& out, const std::vector<std::pair<Tuning, int>>& expansions) {
+    out.emplace_back(expansions.size());
+    for (const std::pair<Tuning, int>& expansion : expansions) {
+        std::size_t count = out.size();
+        out.emplace_back(0);
+        out.emplace_back(static_cast<uint64_t>(static_cast<int64_t>(expansion.second)));
+        putTuning(out, expansion.first);
+        out[count] = (out.size() - count - 2) / 3;
+    }
+}
+
+static uint64_t hashWords(const uint64_t* words, std::size_t n) {
+    uint64_t h = 14695981039346656037ull;
+    for (std::size_t i = 0; i < n; i++) h = (h ^ words[i]) * 1099511628211ull;
+    return h | 1;
+}
+
+// Returns the number of words of the key of the entry at the given words, or
+//   0 if it does not fit in the given number of words
+static std::size_t keyLength(const uint64_t* words, std::size_t n) {
+    if (n < 2 || words[0] > n || words[1] > n) return 0;
+    std::size_t length = 2 + 3 * words[0] + words[1];
+    return length <= n ? length : 0;
+}
+
+// Returns the number of words of the entry at the given words, or 0 if it does
+//   not fit in the given number of words
+static std::size_t entryLength(const uint64_t* words, std::size_t n) {
+    std::size_t length = keyLength(words, n);
+    if (length == 0 || length >= n) return 0;
+    uint64_t expansions = words[length++];
+    for (uint64_t k = 0; k < expansions; k++) {
+        if (length + 2 > n || words[length] > n) return 0;
+        length += 2 + 3 * words[length];
+        if (length > n) return 0;
+    }
+    return length;
+}
+
+///////////////////////////////////////////////////////////////
+
+Algo::DiskCache::DiskCache(): file{}, options{}, slotCount{0}, entries{0}, wordCount{0}, slots{nullptr}, words{nullptr} {}
+
+bool Algo::DiskCache::open(const std::string& name) {
+    slotCount = entries = wordCount = 0;
+    slots = words = nullptr;
+    if (!file.open(name)) return false;
+    CacheHeader header;
+    bool valid = file.size() >= sizeof(header) && (file.size() - sizeof(header)) % 8 == 0;
+    if (valid) {
+		// The sizes are checked against the number of words after the header
+		//   without multiplying them, which could overflow
+        uint64_t available = (file.size() - sizeof(header)) / 8;
+        std::memcpy(&header, file.data(), sizeof(header));
+        valid = std::memcmp(header.magic, CACHE_MAGIC, 4) == 0 && header.version == version && header.orderMark == CACHE_ORDER_MARK
+             && header.slotCount > 0 && (header.slotCount & (header.slotCount - 1)) == 0 && header.entries < header.slotCount
+             && header.slotCount <= available / 2 && header.wordCount == available - 2 * header.slotCount;
+    }
+    if (!valid) {
+        file.close();
+        return false;
+    }
+    options.tier = static_cast<Tier>(header.tier);
+    options.decompose = header.decompose != 0;
+    options.threshold = header.threshold;
+    slotCount = header.slotCount;
+    entries = header.entries;
+    wordCount = header.wordCount;
+    slots = reinterpret_cast<const uint64_t*>(file.data() + sizeof(header));
+    words = slots + 2 * slotCount;
+    return true;
+}
+
+const Algo::Options& Algo::DiskCache::getOptions() const {
+    return options;
+}
+
+unsigned long Algo::DiskCache::size() const {
+    return entries;
+}
+
+bool Algo::DiskCache::find(const Tuning& normal, const std::vector<EPitch>& chord, std::vector<std::pair<Tuning, int>>& expansions) const {
+    if (slotCount == 0) return false;
+    std::vector<uint64_t> key;
+    putKey(key, normal, chord);
+    uint64_t h = hashWords(key.data(), key.size());
+
+	// Entries are checked against the whole key, and are bounds-checked
+	//   since the file is not checked when it is opened. For the same
+	//   reason, a table without an empty slot is probed at most once
+	//   through.
+    uint64_t i = h & (slotCount - 1);
+    for (uint64_t probes = 0; probes < slotCount; probes++, i = (i + 1) & (slotCount - 1)) {
+        uint64_t slotHash = slots[2 * i];
+        if (slotHash == 0) return false;
+        uint64_t at = slots[2 * i + 1];
+        if (slotHash != h || at >= wordCount) continue;
+        std::size_t length = entryLength(words + at, wordCount - at);
+        if (length == 0 || keyLength(words + at, length) != key.size() || !std::equal(key.begin(), key.end(), words + at)) continue;
+
+        expansions.clear();
+        const uint64_t* word = words + at + key.size();
+        for (uint64_t k = 0, n = *word++; k < n; k++) {
+            uint64_t pitches = *word++;
+            int value = static_cast<int>(static_cast<int64_t>(*word++));
+            Tuning tuning;
+            for (uint64_t j = 0; j < pitches; j++, word += 3) {
+                if (word[1] == 0 || word[2] == 0) return false;
+                tuning.addNoteTuning(NoteTuning{wordPitch(word[0]), Frac{word[1], word[2]}});
+            }
+            expansions.emplace_back(std::move(tuning), value);
+        }
+        return true;
+    }
+    return false;
+}
+
+bool Algo::DiskCache::merge(const std::string& name, const SharedCache& cache, unsigned long& added) {
+    added = 0;
+
+	// Hold the lock until the new file has replaced the old one, so that the
+	//   entries of a concurrent merge are not lost
+#if !defined(_WIN32)
+    int lock = ::open((name + ".lock").c_str(), O_RDWR | O_CREAT, 0644);
+    if (lock < 0) return false;
+    ::flock(lock, LOCK_EX);
+#endif
+
+	// Gather the entries of the old file and the new entries, keyed by their
+	//   keys so that an entry is only written once
+    std::vector<uint64_t> entryWords;
+    std::map<std::vector<uint64_t>, uint64_t> starts;
+    DiskCache old;
+    if (old.open(name) && sameSearch(old.options, cache.getOptions())) {
+        for (uint64_t i = 0; i < old.slotCount; i++) {
+            uint64_t at = old.slots[2 * i + 1];
+            if (old.slots[2 * i] == 0 || at >= old.wordCount) continue;
+            std::size_t length = entryLength(old.words + at, old.wordCount - at);
+            if (length == 0) continue;
+            std::vector<uint64_t> key(old.words + at, old.words + at + keyLength(old.words + at, length));
+            if (starts.emplace(key, entryWords.size()).second) entryWords.insert(entryWords.end(), old.words + at, old.words + at + length);
+        }
+    }
+    old.file.close();
+    std::vector<uint64_t> key;
+    cache.forEach([&](const Tuning& normal, const std::vector<EPitch>& chord, const std::vector<std::pair<Tuning, int>>& expansions) {
+        key.clear();
+        putKey(key, normal, chord);
+        if (!starts.emplace(key, entryWords.size()).second) return;
+        entryWords.insert(entryWords.end(), key.begin(), key.end());
+        putExpansions(entryWords, expansions);
+        added++;
+    });
+
+	// The table is kept at most half full
+    uint64_t slotCount = 16;
+    while (slotCount < 2 * starts.size()) slotCount *= 2;
+    std::vector<uint64_t> slots(2 * slotCount, 0);
+    for (auto& entry : starts) {
+        uint64_t h = hashWords(entry.first.data(), entry.first.size());
+        uint64_t i = h & (slotCount - 1);
+        while (slots[2 * i] != 0) i = (i + 1) & (slotCount - 1);
+        slots[2 * i] = h;
+        slots[2 * i + 1] = entry.second;
+    }
+
+    CacheHeader header;
+    std::memcpy(header.magic, CACHE_MAGIC, 4);
+    header.version = version;
+    header.orderMark = CACHE_ORDER_MARK;
+    header.tier = static_cast<uint32_t>(cache.getOptions().tier);
+    header.decompose = cache.getOptions().decompose;
+    header.threshold = cache.getOptions().threshold;
+    header.slotCount = slotCount;
+    header.entries = starts.size();
+    header.wordCount = entryWords.size();
+
+	// The new file is written next to the old one and renamed over it, which
+	//   replaces it at once for the processes that open it next
+    std::string temporary = name + ".tmp";
+    std::FILE* out = std::fopen(temporary.c_str(), "wb");
+    bool written = out && std::fwrite(&header, sizeof(header), 1, out) == 1
+                && std::fwrite(slots.data(), 8, slots.size(), out) == slots.size()
+                && std::fwrite(entryWords.data(), 8, entryWords.size(), out) == entryWords.size();
+    if (out && std::fclose(out) != 0) written = false;
+    std::error_code error;
+    bool replaced = written;
+    if (replaced) {
+        std::filesystem::rename(temporary, name, error);
+        replaced = !error;
+    }
+    if (!replaced) std::filesystem::remove(temporary, error);
+
+#if !defined(_WIN32)
+    ::flock(lock, LOCK_UN);
+    ::close(lock);
+#endif
+    return replaced;
+}
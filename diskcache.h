@@ -0,0 +1,74 @@
+#ifndef _DISKCACHE_H_
+#define _DISKCACHE_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <utility>
+
+#include "pitch.h"
+#include "tunings.h"
+#include "mapped.h"
+#include "algo.h"
+
+namespace Algo {
+
+class SharedCache;
+
+class DiskCache {
+	// Class that reads a cache file of expansions of normalized tunings
+	//   through chords (see Solver), so that solves in one process can reuse
+	//   the expansions found by earlier ones. The file is memory-mapped
+	//   read-only, so any number of processes can read it at once and share
+	//   its pages. It is a hash table of the tuning and the chord of every
+	//   entry, with linear probing, followed by the entries themselves, so
+	//   a lookup reads a few slots and the entry it finds without parsing the
+	//   rest of the file.
+	// The file is never modified in place: merge writes a new file with the
+	//   entries of the old one and those of a SharedCache, and renames it over
+	//   the old one, so that processes that have the old one open keep reading
+	//   it. Merges are serialized with a lock file, so that concurrent merges
+	//   do not lose each other's entries.
+    private:
+        MappedFile file;
+        Options options;
+        uint64_t slotCount;
+        uint64_t entries;
+        uint64_t wordCount;
+        const uint64_t* slots;
+        const uint64_t* words;
+
+    public:
+		// Version of the format of the cache files
+        static const uint32_t version = 2;
+
+		// Create a DiskCache with no file open
+        DiskCache();
+
+		// Open the cache file with the given name. Returns false if it is not
+		//   a cache file of the current version (in which case no file is
+		//   open, and every lookup misses).
+        bool open(const std::string& file);
+
+		// Returns the options of the Solvers the cache was written from. Only
+		//   those compared by sameSearch are kept.
+        const Options& getOptions() const;
+
+		// Returns the number of entries in the cache
+        unsigned long size() const;
+
+		// Same as SharedCache::find. Thread-safe.
+        bool find(const Tuning& normal, const std::vector<EPitch>& chord, std::vector<std::pair<Tuning, int>>& expansions) const;
+
+		// Writes the entries of the cache file with the given name (if it
+		//   exists and was written with options that search the same way as
+		//   those of the given SharedCache, see sameSearch) and the entries of
+		//   the SharedCache to a new cache file, which replaces it. Returns
+		//   true if the file was replaced, setting added to the number of
+		//   entries that were not in it already.
+        static bool merge(const std::string& file, const SharedCache&, unsigned long& added);
+};
+
+}
+
+#endif
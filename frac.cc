@@ -1,6 +1,7 @@
 #include <iostream>
 
 #include "frac.h"
+#include "counters.h"
 
 unsigned long gcd(unsigned long u, unsigned long v) {
     int shift;
@@ -21,6 +22,7 @@ unsigned long gcd(unsigned long u, unsigned long v) {
 }
 
 Frac& Frac::reduce() {
+    COUNT(reductions, 1);
     unsigned long d = gcd(p, q);
     p /= d;
     q /= d;
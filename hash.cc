@@ -20,3 +20,11 @@ std::size_t Hash::operator()(const NoteTuning& nt) const {
     seed ^= std::hash<long>()(nt.tuning.q) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
     return seed;
 }
+
+std::size_t Hash::operator()(const Tuning& t) const {
+    std::size_t seed = 0;
+    for (const NoteTuning& nt : t) {
+        seed ^= operator()(nt) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+    }
+    return seed;
+}
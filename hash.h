@@ -4,11 +4,13 @@
 enum class Int;
 struct EPitch;
 struct NoteTuning;
+class Tuning;
 
 struct Hash {
     std::size_t operator()(const EPitch& p) const;
     std::size_t operator()(const EPitchFreq& p) const;
     std::size_t operator()(const NoteTuning& nt) const;
+    std::size_t operator()(const Tuning& t) const;
 };
 
 #endif
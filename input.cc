@@ -5,6 +5,7 @@
 #include "pitch.h"
 #include "controller.h"
 #include "input.h"
+#include "trace.h"
 
 #define C4Key  65
 #define Cs4Key 87
@@ -42,6 +43,7 @@ void Input::setController(Controller* c) {
 }
 
 void Input::run() {
+	Trace::nameThread("Input");
 	
 	std::vector<Key> keys {
 		{C4Key,  EPitch{Pitch::C, 4},  false},
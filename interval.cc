@@ -1,8 +1,10 @@
+#include <array>
+
 #include "frac.h"
 #include "pitch.h"
 #include "interval.h"
 
-Frac Interval::idealRatios[12] = {
+Interval::Interval(): idealRatios{
     Frac{1, 1}  ,
     Frac{16, 15},
     Frac{9, 8}  ,
@@ -15,15 +17,41 @@ Frac Interval::idealRatios[12] = {
     Frac{5, 3}  ,
     Frac{16, 9} ,
     Frac{15, 8} 
-};
+}, weights{65536, 4, 8, 64, 64, 1024, 1, 1024, 64, 64, 8, 4} {}
 
-int Interval::weights[12] = {65536, 4, 8, 64, 64, 1024, 1, 1024, 64, 64, 8, 4};
+Interval::Interval(const std::array<Frac, 12>& idealRatios, const std::array<int, 12>& weights): idealRatios{idealRatios}, weights{weights} {}
 
-Frac Interval::getIdealRatio(const EPitch& ep1, const EPitch& ep2) {
+Interval& Interval::setIdealRatio(int semitones, const Frac& ratio) {
+    idealRatios[(semitones % 12 + 12) % 12] = ratio;
+    return *this;
+}
+
+Interval& Interval::setWeight(int semitones, int weight) {
+    weights[(semitones % 12 + 12) % 12] = weight;
+    return *this;
+}
+
+Frac Interval::idealRatio(const EPitch& ep1, const EPitch& ep2) const {
     return idealRatios[(static_cast<int>(ep2.pitch) - static_cast<int>(ep1.pitch) + 12) % 12];
 }
 
-int Interval::getWeight(const EPitch& ep1, const EPitch& ep2) {
+int Interval::weight(const EPitch& ep1, const EPitch& ep2) const {
     return weights[(static_cast<int>(ep2.pitch) - static_cast<int>(ep1.pitch) + 12) % 12];
 }
 
+bool Interval::sameWeights(const Interval& other) const {
+    return weights == other.weights;
+}
+
+const Interval& Interval::standard() {
+    static const Interval table;
+    return table;
+}
+
+Frac Interval::getIdealRatio(const EPitch& ep1, const EPitch& ep2) {
+    return standard().idealRatio(ep1, ep2);
+}
+
+int Interval::getWeight(const EPitch& ep1, const EPitch& ep2) {
+    return standard().weight(ep1, ep2);
+}
@@ -1,24 +1,59 @@
 #ifndef _INTERVAL_H_
 #define _INTERVAL_H_
 
-class Frac;
-class EPitch;
+#include <array>
+
+#include "frac.h"
+
+struct EPitch;
 
 class Interval {
-	// Class that represents an interval between two pitches and provides
-	//   two methods to get the interval's ideal ratio and weight, intended
-	//   for use by the optimization algorithms in this project
+	// Class that represents a table of intervals between two pitches and
+	//   provides methods to get an interval's ideal ratio and weight, intended
+	//   for use by the optimization algorithms in this project. The static
+	//   methods use the standard table; other tables (e.g. with a 7/4 minor
+	//   seventh) can be constructed and passed to the solvers that accept them.
     private:
-        static Frac idealRatios[12];
-        static int weights[12];
-		
+        std::array<Frac, 12> idealRatios;
+        std::array<int, 12> weights;
+
     public:
-		// For the two methods below, the interval is the distance between the
+		// Create a table with the standard ideal ratios and weights
+        Interval();
+
+		// Create a table with the given ideal ratios and weights, indexed by
+		//   the number of semitones in the interval (0 to 11)
+        Interval(const std::array<Frac, 12>& idealRatios, const std::array<int, 12>& weights);
+
+		// Set the ideal ratio or the weight of the interval with the given
+		//   number of semitones, which is reduced to an interval within the
+		//   octave (0 to 11) like the intervals below, e.g. 14 and -10 set the
+		//   major second. Returns itself for chaining.
+        Interval& setIdealRatio(int semitones, const Frac& ratio);
+        Interval& setWeight(int semitones, int weight);
+
+		// For the methods below, the interval is the distance between the
 		//   given start and end pitches. If the distance between them is 
 		//   larger than one octave or if the interval is inverted, adjust
 		//   the interval accordingly so that it is between a perfect unison
 		//   (the smallest interval) and a major seventh (the largest interval)
 
+		// Returns a Frac object corresponding to the ideal ratio to tune the
+		//   interval in, according to this table
+        Frac idealRatio(const EPitch& start, const EPitch& end) const;
+
+		// Returns the weight of the interval according to this table
+        int weight(const EPitch& start, const EPitch& end) const;
+
+		// Returns true if the two tables have the same weight for every
+		//   interval (their ideal ratios may differ)
+        bool sameWeights(const Interval& other) const;
+
+		// Returns the standard table. The solvers look it up once per search
+		//   and pass it down, rather than calling the static methods below
+		//   for every pair of pitches.
+        static const Interval& standard();
+
 		// Returns a Frac object corresponding to the ideal ratio to tune the
 		//   interval in, according to Pythagorean theory. For example, if the
 		//   current interval object represents a minor sixth, the ratio would
@@ -1,78 +1,235 @@
 #include <iostream>
-#include <iomanip>
+#include <fstream>
+#include <string>
 #include <vector>
-#include <list>
-#include <map>
-#include <unordered_map>
-
-#include "frac.h"
-#include "pitch.h"
-#include "interval.h"
-#include "tunings.h"
-#include "hash.h"
-#include "algo.h"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <thread>
+#include <cstdlib>
+#include <cctype>
+#include <memory>
+
+#if !defined(_WIN32)
+#include <sys/resource.h>
+#endif
+
 #include "score.h"
+#include "algo.h"
+#include "solver.h"
+#include "midi.h"
+#include "scoretext.h"
+#include "workers.h"
+#include "diskcache.h"
+
+using namespace std::chrono;
+namespace fs = std::filesystem;
+
+struct Job {
+	// An input score, the file its solved score is written to, and the outcome
+	//   of solving it: whether it succeeded, the length of the score in beats,
+	//   whether it was solved hierarchically, and the time taken
+    fs::path input;
+    fs::path output;
+    bool done = false;
+    unsigned int beats = 0;
+    bool split = false;
+    double milliseconds = 0;
+    unsigned long diskLookups = 0;
+    unsigned long diskHits = 0;
+    unsigned long diskNanoseconds = 0;
+};
+
+void usage() {
+    std::cerr << "usage: tuner [options] input...\n"
+              << "Tunes every input MIDI file or .score text score (or every such file under\n"
+              << "an input directory) and writes the tuned MIDI files to the output directory.\n"
+              << "  --threads N   number of threads (default: the number of cores)\n"
+              << "  --out DIR     output directory (default: tuned)\n"
+              << "  --list FILE   also tune the files listed in FILE, one per line\n"
+              << "  --split N     solve scores longer than N beats hierarchically, sharing\n"
+              << "                their spans between threads; 0 never does (default: 256)\n"
+              << "  --bend        retune with pitch bends instead of MTS messages\n"
+              << "  --cache FILE  reuse the chord expansions in the cache file FILE, and add\n"
+              << "                the expansions found to it" << std::endl;
+}
+
+// Returns the peak resident memory of the process in kilobytes, or 0 if it is
+//   not known
+long peakMemory() {
+#if !defined(_WIN32)
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) return usage.ru_maxrss;
+#endif
+    return 0;
+}
+
+std::string extension(const fs::path& file) {
+    std::string extension = file.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return std::tolower(c); });
+    return extension;
+}
+
+bool isMidi(const fs::path& file) {
+    return extension(file) == ".mid" || extension(file) == ".midi" || extension(file) == ".smf";
+}
+
+// Text scores (see readScore) are tuned the same way, and written as MIDI files
+bool isText(const fs::path& file) {
+    return extension(file) == ".score";
+}
+
+fs::path outputOf(const fs::path& output) {
+    return isText(output) ? fs::path{output}.replace_extension(".mid") : output;
+}
 
-int main() {
-	
-	// EXAMPLE
-
-    /*
-    Score test = Score{}.add(EPitch{Pitch::C, 4}, 4, 1)
-                        .add(EPitch{Pitch::Cs, 4}, 4, 1)
-                        .add(EPitch{Pitch::D, 4}, 4, 1)
-                        .add(EPitch{Pitch::Ds, 4}, 4, 1);
-    test.calculateFreqs();
-
-    for (auto it = test.nbegin(); it != test.nend(); ++it) {
-        std::cout << (*it).pitch << std::endl;
-    }*/
-
-    Tuning tuning = Tuning{};
-    std::list<EPitch> notes = std::list<EPitch>{
-        EPitch{Pitch::C, 4},
-        EPitch{Pitch::D, 4},
-        EPitch{Pitch::Fs, 4},
-        EPitch{Pitch::A, 4},
-        EPitch{Pitch::As, 4}
-    };
-
-    /*
-    Tuning tuning = Tuning{}.addNoteTuning(NoteTuning{EPitch{Pitch::C, 3}, Frac{80, 243}})
-                            .addNoteTuning(NoteTuning{EPitch{Pitch::F, 3}, Frac{25600, 59049}})
-                            .addNoteTuning(NoteTuning{EPitch{Pitch::Gs, 3}, Frac{10000, 19683}})
-                            .addNoteTuning(NoteTuning{EPitch{Pitch::B, 3}, Frac{4000, 6561}})
-                            .addNoteTuning(NoteTuning{EPitch{Pitch::D, 4}, Frac{3125, 4374}})
-                            .addNoteTuning(NoteTuning{EPitch{Pitch::E, 4}, Frac{3125, 3888}})
-                            .addNoteTuning(NoteTuning{EPitch{Pitch::F, 4}, Frac{51200, 59049}})
-                            .addNoteTuning(NoteTuning{EPitch{Pitch::Cs, 5}, Frac{80000, 59049}})
-                            .addNoteTuning(NoteTuning{EPitch{Pitch::D, 5}, Frac{3125, 2187}})
-                            .addNoteTuning(NoteTuning{EPitch{Pitch::E, 5}, Frac{3125, 1944}});
-    std::list<EPitch> notes = std::list<EPitch> {
-        EPitch{Pitch::G, 3},
-        EPitch{Pitch::F, 4},
-        EPitch{Pitch::D, 5},
-        EPitch{Pitch::C, 3},
-        EPitch{Pitch::E, 4},
-        EPitch{Pitch::F, 3},
-        EPitch{Pitch::Gs, 3},
-        EPitch{Pitch::B, 3},
-        EPitch{Pitch::D, 4},
-        EPitch{Pitch::G, 4},
-        EPitch{Pitch::Cs, 5},
-        EPitch{Pitch::E, 5}
-    };*/
-
-    std::map<Tuning, int> m1 = Algo::getValuesSelectiveRec(tuning, notes);
-    std::cout << "done selective" << std::endl;
-    std::map<Tuning, int> m2 = Algo::getValuesRec(tuning, notes);
-
-    for (auto p : m1) {
-        std::cout << p.first << " " << p.second << std::endl;
+// Adds a job for the given file, or for every MIDI file under the given
+//   directory, whose output keeps its path relative to the directory
+void addJobs(const fs::path& input, const fs::path& out, std::vector<Job>& jobs) {
+    std::error_code error;
+    if (!fs::is_directory(input, error)) {
+        jobs.emplace_back(Job{input, outputOf(out / input.filename())});
+        return;
+    }
+    std::vector<fs::path> files;
+    for (fs::recursive_directory_iterator it{input, error}, end; !error && it != end; it.increment(error)) {
+        if (it->is_regular_file(error) && (isMidi(it->path()) || isText(it->path()))) files.emplace_back(it->path());
     }
-    std::cout << std::endl;
+    std::sort(files.begin(), files.end());
+    for (const fs::path& file : files) jobs.emplace_back(Job{file, outputOf(out / fs::relative(file, input, error))});
+}
 
-    for (auto p : m2) {
-        std::cout << p.first << " " << p.second << std::endl;
+void solve(Job& job, unsigned int split, Retuning retuning, Workers& workers, const std::shared_ptr<Algo::SharedCache>& shared) {
+    auto start = steady_clock::now();
+    Score score;
+    if (isText(job.input) ? readScore(job.input.string(), score) : readMidi(job.input.string(), score)) {
+        job.beats = score.getLength() / score.getResolution();
+        job.split = split > 0 && job.beats > split;
+
+		// An empty score (e.g. a file with only percussion) has nothing to
+		//   tune, and is written through as it is
+        if (job.split) {
+            Hierarchy hierarchy;
+            hierarchy.workers = &workers;
+            HierarchyReport report = score.calculateFreqs(Algo::Options{}, hierarchy, shared);
+            job.diskLookups = report.diskLookups;
+            job.diskHits = report.diskHits;
+            job.diskNanoseconds = report.diskNanoseconds;
+        } else if (score.getLength() > 0) {
+            Algo::Stats stats = score.calculateFreqs(Algo::Options{}, shared);
+            job.diskLookups = stats.diskLookups;
+            job.diskHits = stats.diskHits;
+            job.diskNanoseconds = stats.diskNanoseconds;
+        }
+        std::error_code error;
+        fs::create_directories(job.output.parent_path(), error);
+        job.done = writeMidi(job.output.string(), score, retuning);
+    }
+    job.milliseconds = duration_cast<microseconds>(steady_clock::now() - start).count() / 1000.0;
+}
+
+int main(int argc, char* argv[]) {
+    unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+    unsigned int split = 256;
+    fs::path out = "tuned";
+    Retuning retuning = Retuning::TuningStandard;
+    std::string cache;
+    std::vector<fs::path> inputs;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--threads" && hasValue) {
+            threads = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--out" && hasValue) {
+            out = argv[++i];
+        } else if (arg == "--split" && hasValue) {
+            split = std::max(0, std::atoi(argv[++i]));
+        } else if (arg == "--cache" && hasValue) {
+            cache = argv[++i];
+        } else if (arg == "--bend") {
+            retuning = Retuning::PitchBend;
+        } else if (arg == "--list" && hasValue) {
+            std::ifstream list{argv[++i]};
+            if (!list) {
+                std::cerr << "cannot read " << argv[i] << std::endl;
+                return 2;
+            }
+            for (std::string line; std::getline(list, line);) {
+                if (!line.empty()) inputs.emplace_back(line);
+            }
+        } else if (arg.size() > 1 && arg[0] == '-') {
+            usage();
+            return 2;
+        } else {
+            inputs.emplace_back(arg);
+        }
+    }
+    if (inputs.empty()) {
+        usage();
+        return 2;
+    }
+
+    std::vector<Job> jobs;
+    for (const fs::path& input : inputs) addJobs(input, out, jobs);
+
+	// Every solve looks expansions up in the same shared cache, backed by the
+	//   cache file if there is one (a missing or stale file is rebuilt by the
+	//   merge below)
+    std::shared_ptr<Algo::SharedCache> shared;
+    if (!cache.empty()) {
+        auto disk = std::make_shared<Algo::DiskCache>();
+        disk->open(cache);
+        shared = std::make_shared<Algo::SharedCache>(Algo::Options{}, disk);
+    }
+
+	// Every file is a task, and the spans of a long file are tasks of their
+	//   own, so idle threads steal work from the files that are still running
+    auto start = steady_clock::now();
+    Workers workers{threads};
+    workers.forEach(jobs.size(), [&](unsigned int k) { solve(jobs[k], split, retuning, workers, shared); });
+    double seconds = duration_cast<microseconds>(steady_clock::now() - start).count() / 1e6;
+
+    std::vector<double> latencies;
+    unsigned long beats = 0;
+    unsigned long diskLookups = 0, diskHits = 0, diskNanoseconds = 0;
+    unsigned int failed = 0;
+    for (const Job& job : jobs) {
+        if (!job.done) {
+            std::cout << job.input.string() << ": failed" << std::endl;
+            failed++;
+            continue;
+        }
+        std::cout << job.input.string() << " -> " << job.output.string() << ": " << job.beats << " beats"
+                  << (job.split ? " (split)" : "") << ", " << job.milliseconds << " ms" << std::endl;
+        latencies.emplace_back(job.milliseconds);
+        beats += job.beats;
+        diskLookups += job.diskLookups;
+        diskHits += job.diskHits;
+        diskNanoseconds += job.diskNanoseconds;
+    }
+
+    std::cout << "tuned " << latencies.size() << " of " << jobs.size() << " files in " << seconds << " s with "
+              << workers.size() << " threads: " << latencies.size() / seconds << " files/s, " << beats / seconds
+              << " beats/s" << std::endl;
+    if (!latencies.empty()) {
+        std::sort(latencies.begin(), latencies.end());
+        auto at = [&](double q) { return latencies[static_cast<std::size_t>(q * (latencies.size() - 1))]; };
+        std::cout << "latency per file: min " << latencies.front() << " ms, median " << at(0.5) << " ms, p95 "
+                  << at(0.95) << " ms, max " << latencies.back() << " ms" << std::endl;
+    }
+    if (shared) {
+        std::cout << "cache: " << diskHits << " of " << diskLookups << " lookups hit";
+        if (diskLookups > 0) {
+            std::cout << " (" << 100.0 * diskHits / diskLookups << "%), " << diskNanoseconds / 1000.0 / diskLookups << " us per lookup";
+        }
+        std::cout << std::endl;
+        unsigned long added;
+        if (Algo::DiskCache::merge(cache, *shared, added)) {
+            std::cout << "cache: added " << added << " entries to " << cache << std::endl;
+        } else {
+            std::cout << "cache: cannot write " << cache << std::endl;
+        }
     }
+    std::cout << "peak memory: " << peakMemory() / 1024.0 << " MB" << std::endl;
+    return failed > 0 ? 1 : 0;
 }
@@ -0,0 +1,64 @@
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "mapped.h"
+
+MappedFile::MappedFile(): bytes{nullptr}, length{0}, buffer{} {}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::open(const std::string& file, bool sequential) {
+    close();
+#if defined(_WIN32)
+    std::FILE* in = std::fopen(file.c_str(), "rb");
+    if (!in) return false;
+    unsigned char chunk[1 << 16];
+    for (std::size_t n; (n = std::fread(chunk, 1, sizeof(chunk), in)) > 0;) buffer.insert(buffer.end(), chunk, chunk + n);
+    std::fclose(in);
+    bytes = buffer.data();
+    length = buffer.size();
+    return length > 0;
+#else
+    int fd = ::open(file.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat info;
+    if (::fstat(fd, &info) != 0 || info.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+    void* mapped = ::mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) return false;
+    if (sequential) ::madvise(mapped, info.st_size, MADV_SEQUENTIAL);
+    bytes = static_cast<const unsigned char*>(mapped);
+    length = info.st_size;
+    return true;
+#endif
+}
+
+void MappedFile::close() {
+#if !defined(_WIN32)
+    if (bytes) ::munmap(const_cast<unsigned char*>(bytes), length);
+#endif
+    bytes = nullptr;
+    length = 0;
+    buffer.clear();
+}
+
+const unsigned char* MappedFile::data() const {
+    return bytes;
+}
+
+std::size_t MappedFile::size() const {
+    return length;
+}
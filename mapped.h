@@ -0,0 +1,43 @@
+#ifndef _MAPPED_H_
+#define _MAPPED_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+class MappedFile {
+	// Class that gives read-only access to the contents of a file by mapping
+	//   it into memory, so that the pages of the file are only read when they
+	//   are first used and are shared with other processes reading the same
+	//   file. On platforms without mmap, the file is read into a buffer.
+	//   The file stays mapped until it is closed or the object is destroyed.
+    private:
+        const unsigned char* bytes;
+        std::size_t length;
+        std::vector<unsigned char> buffer;
+
+    public:
+		// Create an object with no file open
+        MappedFile();
+
+		// Unmap the file, if one is open
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+		// Map the file with the given name, closing the file that was open.
+		//   If sequential is true, the file is expected to be read from start to
+		//   end once. Returns false if the file could not be opened or is empty.
+        bool open(const std::string& file, bool sequential = false);
+
+		// Unmap the file that was open, if any
+        void close();
+
+		// Returns the contents of the open file, which are valid until it is
+		//   closed, and their size in bytes
+        const unsigned char* data() const;
+        std::size_t size() const;
+};
+
+#endif
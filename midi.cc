@@ -0,0 +1,346 @@
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <utility>
+#include <queue>
+#include <functional>
+#include <algorithm>
+
+#include "pitch.h"
+#include "score.h"
+#include "mapped.h"
+#include "midi.h"
+
+const unsigned char PERCUSSION = 9;
+
+///////////////////////////////////////////////////////////////
+// Decoding helpers
+
+struct MidiReader {
+	// Cursor over the bytes of a file; reads past the end set the failure
+	//   flag instead of overrunning
+    const unsigned char* at;
+    const unsigned char* end;
+    bool failed;
+
+    bool has(std::size_t n) {
+        if (static_cast<std::size_t>(end - at) < n) failed = true;
+        return !failed;
+    }
+
+    unsigned char byte() {
+        return has(1) ? *at++ : 0;
+    }
+
+    uint32_t fixed(int bytes) {
+        uint32_t n = 0;
+        if (!has(bytes)) return 0;
+        for (int i = 0; i < bytes; i++) n = (n << 8) | *at++;
+        return n;
+    }
+
+    uint32_t varLen() {
+        uint32_t n = 0;
+        for (int i = 0; i < 4; i++) {
+            unsigned char b = byte();
+            n = (n << 7) | (b & 0x7f);
+            if (!(b & 0x80)) return n;
+        }
+        failed = true;
+        return 0;
+    }
+
+    void skip(std::size_t n) {
+        if (has(n)) at += n;
+    }
+};
+
+static EPitch midiPitch(unsigned char key) {
+    return EPitch{static_cast<Pitch>(key % 12), key / 12 - 1};
+}
+
+// Reads the events of the track in the given reader into the score. Notes
+//   are keyed by channel and key, and a key struck again while it sounds
+//   releases the earlier note.
+static bool readTrack(MidiReader track, Score& score) {
+    std::vector<uint32_t> sounding(16 * 128, UINT32_MAX);
+    auto release = [&](unsigned int note, uint32_t tick) {
+        uint32_t start = sounding[note];
+        sounding[note] = UINT32_MAX;
+        if (start < tick) score.add(midiPitch(note % 128), tick - start, start + 1);
+    };
+
+    uint32_t tick = 0;
+    unsigned char status = 0;
+    while (track.at != track.end) {
+        tick += track.varLen();
+        if (!track.has(1)) return false;
+        if (*track.at & 0x80) {
+            status = *track.at++;
+        } else if (status < 0x80) {
+            return false;
+        }
+
+        if (status < 0xf0) {
+            unsigned char key = track.byte();
+            unsigned char velocity = (status & 0xe0) == 0xc0 ? 0 : track.byte();
+            if (track.failed) return false;
+            unsigned char channel = status & 0x0f;
+            unsigned char type = status & 0xf0;
+            if (channel == PERCUSSION || (type != 0x80 && type != 0x90)) continue;
+            unsigned int note = 128 * channel + (key & 0x7f);
+            if (sounding[note] != UINT32_MAX) release(note, tick);
+            if (type == 0x90 && velocity > 0) sounding[note] = tick;
+        } else if (status == 0xff) {
+			// Meta events and system exclusive messages cancel the running status
+            unsigned char type = track.byte();
+            track.skip(track.varLen());
+            status = 0;
+            if (type == 0x2f) break;
+        } else if (status == 0xf0 || status == 0xf7) {
+            track.skip(track.varLen());
+            status = 0;
+        } else {
+            return false;
+        }
+        if (track.failed) return false;
+    }
+
+    for (unsigned int note = 0; note < sounding.size(); note++) {
+        if (sounding[note] != UINT32_MAX) release(note, tick);
+    }
+    return true;
+}
+
+///////////////////////////////////////////////////////////////
+
+bool readMidi(const unsigned char* data, std::size_t size, Score& score) {
+    MidiReader file{data, data + size, false};
+    if (!file.has(14) || std::memcmp(file.at, "MThd", 4) != 0) return false;
+    file.skip(4);
+    uint32_t headerLength = file.fixed(4);
+    unsigned int format = file.fixed(2);
+    unsigned int tracks = file.fixed(2);
+    unsigned int division = file.fixed(2);
+    if (headerLength < 6 || format > 1 || division == 0 || (division & 0x8000)) return false;
+    file.skip(headerLength - 6);
+
+    Score read{division};
+    for (unsigned int t = 0; t < tracks && !file.failed;) {
+        if (!file.has(8)) return false;
+        bool isTrack = std::memcmp(file.at, "MTrk", 4) == 0;
+        file.skip(4);
+        uint32_t length = file.fixed(4);
+        if (!file.has(length)) return false;
+
+		// Chunks of unknown types are skipped
+        if (isTrack) {
+            if (!readTrack(MidiReader{file.at, file.at + length, false}, read)) return false;
+            t++;
+        }
+        file.skip(length);
+    }
+    if (file.failed) return false;
+
+    score = std::move(read);
+    return true;
+}
+
+bool readMidi(const std::string& name, Score& score) {
+    MappedFile file;
+    return file.open(name, true) && readMidi(file.data(), file.size(), score);
+}
+
+///////////////////////////////////////////////////////////////
+// Encoding helpers
+
+struct MidiWriter {
+	// Writes the events of a track to a file as they are produced, each with
+	//   the time since the previous event, counting the bytes written
+    std::FILE* out;
+    uint32_t tick;
+    uint32_t length;
+
+    void put(unsigned char b) {
+        std::fputc(b, out);
+        length++;
+    }
+
+    void varLen(uint32_t n) {
+        int shift = 21;
+        while (shift > 0 && !(n >> shift)) shift -= 7;
+        for (; shift > 0; shift -= 7) put(0x80 | ((n >> shift) & 0x7f));
+        put(n & 0x7f);
+    }
+
+    void event(uint32_t at, const unsigned char* bytes, std::size_t n) {
+        varLen(at - tick);
+        tick = at;
+        std::fwrite(bytes, 1, n, out);
+        length += n;
+    }
+
+    void channel(uint32_t at, unsigned char status, unsigned char data1, unsigned char data2) {
+        unsigned char bytes[3] = {status, data1, data2};
+        event(at, bytes, 3);
+    }
+};
+
+static void putFixed(std::FILE* out, uint32_t n, int bytes) {
+    for (int i = bytes - 1; i >= 0; i--) std::fputc((n >> (8 * i)) & 0xff, out);
+}
+
+// Returns the MIDI key of the given pitch, which may be out of range
+static int midiKey(const EPitch& pitch) {
+    return 12 * (pitch.octave + 1) + static_cast<int>(pitch.pitch);
+}
+
+// Returns the given frequency in semitones above C-(-1), MIDI key 0, or the
+//   given key if the frequency has not been calculated
+static double midiSemitones(double freq, int key) {
+    return freq > 0 ? 69 + 12 * std::log2(freq / 440.0) : key;
+}
+
+///////////////////////////////////////////////////////////////
+
+bool writeMidi(const std::string& name, const Score& score, Retuning retuning) {
+    if (score.getResolution() >= 0x8000) return false;
+    std::FILE* out = std::fopen(name.c_str(), "wb");
+    if (!out) return false;
+    std::fwrite("MThd", 1, 4, out);
+    putFixed(out, 6, 4);
+    putFixed(out, 0, 2);
+    putFixed(out, 1, 2);
+    putFixed(out, score.getResolution(), 2);
+    std::fwrite("MTrk", 1, 4, out);
+    long lengthAt = std::ftell(out);
+    putFixed(out, 0, 4);
+    MidiWriter track{out, 0, 0};
+
+	// With pitch bends, every channel but the percussion channel is used, and
+	//   its bend range is set to 2 semitones
+    const bool bend = retuning == Retuning::PitchBend;
+    if (bend) {
+        for (unsigned char c = 0; c < 16; c++) {
+            if (c == PERCUSSION) continue;
+            track.channel(0, 0xb0 | c, 101, 0);
+            track.channel(0, 0xb0 | c, 100, 0);
+            track.channel(0, 0xb0 | c, 6, 2);
+            track.channel(0, 0xb0 | c, 38, 0);
+        }
+    }
+
+	// The last frequency written for every key of the score and, for sounding
+	//   notes, the channel and key they are played on. The notes are released
+	//   in order of their release ticks.
+    std::vector<double> written(128, 0.0);
+    std::vector<int> channelOf(128, -1);
+    std::vector<unsigned char> playedKey(128, 0);
+    std::vector<unsigned int> users(16, 0);
+    unsigned char nextChannel = 0;
+    std::priority_queue<std::pair<uint32_t, int>, std::vector<std::pair<uint32_t, int>>, std::greater<std::pair<uint32_t, int>>> releases;
+    std::vector<unsigned char> message;
+
+    auto release = [&](uint32_t tick) {
+        for (; !releases.empty() && releases.top().first <= tick; releases.pop()) {
+            int key = releases.top().second;
+            unsigned char c = bend ? channelOf[key] : 0;
+            track.channel(releases.top().first - 1, 0x80 | c, bend ? playedKey[key] : key, 0);
+            users[c]--;
+            channelOf[key] = -1;
+        }
+    };
+    auto pitchBend = [&](uint32_t tick, unsigned char c, double semitones) {
+        long value = std::lround(8192 + semitones * 4096);
+        value = std::max(0l, std::min(16383l, value));
+        track.channel(tick - 1, 0xe0 | c, value & 0x7f, value >> 7);
+    };
+    auto flush = [&](uint32_t tick) {
+        if (message.size() <= 7) return;
+        message[6] = (message.size() - 7) / 4;
+        message.emplace_back(0xf7);
+        track.varLen(tick - 1 - track.tick);
+        track.tick = tick - 1;
+        track.put(0xf0);
+        track.varLen(message.size() - 1);
+        std::fwrite(message.data() + 1, 1, message.size() - 1, out);
+        track.length += message.size() - 1;
+        message.resize(7);
+    };
+
+	// MTS messages retune keys of tuning program 0 of every device in real
+	//   time, so they also retune the notes sounding on them
+    message = {0xf0, 0x7f, 0x7f, 0x08, 0x02, 0x00, 0x00};
+
+    auto note = score.nbegin();
+    auto notesEnd = score.nend();
+    FreqSpan segment{nullptr, nullptr, 0};
+    uint32_t tick = 1;
+    for (FreqSpan sounding : score) {
+        release(tick);
+
+		// The frequencies only change where a segment of the score ends
+        if (sounding.pitches != segment.pitches || sounding.length != segment.length) {
+            segment = sounding;
+            for (unsigned int i = 0; i < sounding.length; i++) {
+                int key = midiKey(sounding.pitches[i]);
+                if (key < 0 || key > 127 || written[key] == sounding.freqs[i]) continue;
+                written[key] = sounding.freqs[i];
+                double semitones = midiSemitones(sounding.freqs[i], key);
+                if (bend) {
+                    if (channelOf[key] >= 0) pitchBend(tick, channelOf[key], semitones - playedKey[key]);
+                    continue;
+                }
+				// The data of a key is the key at or below its frequency and the
+				//   fraction of a semitone above that key, in units of 1/16384
+				//   semitone; 7f 7f 7f is reserved for leaving a key unchanged
+                int base = std::max(0, std::min(127, static_cast<int>(std::floor(semitones))));
+                long fraction = std::max(0l, std::min(base == 127 ? 16382l : 16383l, std::lround((semitones - base) * 16384)));
+                message.insert(message.end(), {static_cast<unsigned char>(key), static_cast<unsigned char>(base),
+                                               static_cast<unsigned char>(fraction >> 7), static_cast<unsigned char>(fraction & 0x7f)});
+                if (message.size() == 7 + 4 * 127) flush(tick);
+            }
+            flush(tick);
+        }
+
+        for (; note != notesEnd && static_cast<uint32_t>((*note).startBeat) == tick; ++note) {
+            Note n = *note;
+            int key = midiKey(n.pitch.pitch);
+            if (key < 0 || key > 127) continue;
+            unsigned char c = 0;
+            if (bend) {
+				// Use the next free channel, or the next channel if every
+				//   channel is in use
+                c = nextChannel;
+                for (unsigned char k = 0; k < 16; k++) {
+                    unsigned char candidate = (nextChannel + k) % 16;
+                    if (candidate != PERCUSSION && users[candidate] == 0) {
+                        c = candidate;
+                        break;
+                    }
+                }
+                if (c == PERCUSSION) c = (c + 1) % 16;
+                nextChannel = (c + 1) % 16;
+                double semitones = midiSemitones(n.pitch.freq, key);
+                playedKey[key] = std::max(0, std::min(127, static_cast<int>(std::lround(semitones))));
+                pitchBend(tick, c, semitones - playedKey[key]);
+                channelOf[key] = c;
+            }
+            users[c]++;
+            track.channel(tick - 1, 0x90 | c, bend ? playedKey[key] : key, 100);
+            releases.emplace(tick + n.duration, key);
+        }
+        tick++;
+    }
+    release(UINT32_MAX);
+
+    const unsigned char endOfTrack[3] = {0xff, 0x2f, 0x00};
+    track.event(track.tick, endOfTrack, 3);
+    std::fseek(out, lengthAt, SEEK_SET);
+    putFixed(out, track.length, 4);
+    bool failed = std::ferror(out);
+    return std::fclose(out) == 0 && !failed;
+}
@@ -0,0 +1,51 @@
+#ifndef _MIDI_H_
+#define _MIDI_H_
+
+#include <cstddef>
+#include <string>
+
+class Score;
+
+enum class Retuning {
+	// How writeMidi retunes the notes it writes: with MIDI Tuning Standard
+	//   single note tuning changes, which retune every key of a synthesizer
+	//   separately, or with pitch bends, for synthesizers that do not support
+	//   MTS. Pitch bends retune a whole channel, so every note sounding at once
+	//   is played on its own channel.
+    TuningStandard, PitchBend
+};
+
+// Reads the Standard MIDI File (format 0 or 1) with the given name into the
+//   given score, replacing its contents. The file is memory-mapped and its
+//   events are read in a single pass, so that every note is added to the
+//   score as soon as it is released, without storing the events of the file.
+//   The ticks of the file become the ticks of the score (shifted so that the
+//   file starts on tick 1), and the resolution of the score is the number of
+//   ticks in a quarter note of the file, so tempo changes are ignored.
+//   Notes on channel 10 (General MIDI percussion) are ignored, and notes
+//   still sounding at the end of their track are released there.
+//   Returns true if the file was read, and false if it could not be opened,
+//   is malformed, or uses SMPTE time or format 2 (in which case the score
+//   is left unmodified).
+bool readMidi(const std::string& file, Score&);
+
+// Same as above, but reads the file from the given number of bytes in memory
+bool readMidi(const unsigned char* data, std::size_t size, Score&);
+
+// Writes the given score to a Standard MIDI File (format 0) with the given
+//   name, tuning every note to its frequency in the score, so the score must
+//   have been solved with calculateFreqs. The file is written as the score is
+//   iterated, and a retuning is written only when the frequency of a key
+//   changes: with MTS, before a note starts on the key or while it sounds,
+//   and with pitch bends, on the channel of a sounding note (a note that
+//   starts is bent on its channel before it starts). Pitch bends have a
+//   range of 2 semitones around the key closest to the frequency of a note
+//   when it starts, and when more than 15 notes sound at once, some of them
+//   share a channel. Pitches outside of the range of MIDI keys are left out.
+//   The ticks of the file are the ticks of the score, with the resolution of
+//   the score as the number of ticks in a quarter note. Returns true if the
+//   file was written, and false if it could not be, or if the resolution of
+//   the score is too large for a MIDI file.
+bool writeMidi(const std::string& file, const Score&, Retuning = Retuning::TuningStandard);
+
+#endif
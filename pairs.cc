@@ -0,0 +1,144 @@
+#include <vector>
+#include <list>
+#include <utility>
+#include <algorithm>
+
+#include "pitch.h"
+#include "interval.h"
+#include "tunings.h"
+#include "pairs.h"
+
+PairQueue::PairQueue(const Tuning& fixed, const std::vector<EPitch>& var, const Interval& intervals):
+    intervals{intervals}, pitches{var}, levels{}, weights{}, totals{}, counts{}, isFixed(var.size(), false),
+    best(var.size(), -1), first(var.size(), NoteTuning{EPitch{Pitch::C, 4}, Frac{1, 1}}), fixedSlots{}, saved{} {
+
+    for (int s = 0; s < 12; s++) {
+        weights.emplace_back(intervals.weight(EPitch{Pitch::C, 4}, EPitch{static_cast<Pitch>(s), 4}));
+    }
+    std::vector<int> semitoneWeights{weights};
+    std::sort(weights.begin(), weights.end());
+    weights.erase(std::unique(weights.begin(), weights.end()), weights.end());
+    for (int s = 0; s < 12; s++) {
+        levels[s] = std::lower_bound(weights.begin(), weights.end(), semitoneWeights[s]) - weights.begin();
+    }
+
+    unsigned int n = pitches.size();
+    totals.assign(weights.size(), 0);
+    counts.assign(n * weights.size(), 0);
+    for (unsigned int t = 0; t < n; t++) {
+        for (unsigned int u = 0; u < n; u++) {
+            if (pitches[t] == pitches[u]) continue;
+            unsigned int l = level(pitches[t], pitches[u]);
+            counts[t * weights.size() + l]++;
+            totals[l]++;
+        }
+    }
+
+    for (const NoteTuning& nt : fixed) {
+        for (unsigned int t = 0; t < n; t++) {
+            int w = intervals.weight(nt.pitch, pitches[t]);
+            if (w > best[t]) {
+                best[t] = w;
+                first[t] = nt;
+            }
+        }
+    }
+}
+
+unsigned int PairQueue::level(const EPitch& start, const EPitch& end) const {
+    return levels[(static_cast<int>(end.pitch) - static_cast<int>(start.pitch) + 12) % 12];
+}
+
+void PairQueue::fix(const NoteTuning& nt) {
+    unsigned int n = pitches.size();
+    unsigned int slot = 0;
+    while (isFixed[slot] || !(pitches[slot] == nt.pitch)) slot++;
+
+    isFixed[slot] = true;
+    fixedSlots.emplace_back(slot);
+    for (unsigned int t = 0; t < n; t++) {
+        saved.emplace_back(best[t], first[t]);
+        if (isFixed[t]) continue;
+
+        int w = intervals.weight(nt.pitch, pitches[t]);
+        if (w > best[t] || (w == best[t] && nt < first[t])) {
+            best[t] = w;
+            first[t] = nt;
+        }
+
+        if (pitches[t] == nt.pitch) continue;
+        counts[t * weights.size() + level(pitches[t], nt.pitch)]--;
+        totals[level(pitches[t], nt.pitch)]--;
+        totals[level(nt.pitch, pitches[t])]--;
+    }
+}
+
+void PairQueue::unfix() {
+    unsigned int n = pitches.size();
+    unsigned int slot = fixedSlots.back();
+    fixedSlots.pop_back();
+
+    for (unsigned int t = n; t-- > 0;) {
+        best[t] = saved.back().first;
+        first[t] = saved.back().second;
+        saved.pop_back();
+        if (isFixed[t] || pitches[t] == pitches[slot]) continue;
+
+        counts[t * weights.size() + level(pitches[t], pitches[slot])]++;
+        totals[level(pitches[t], pitches[slot])]++;
+        totals[level(pitches[slot], pitches[t])]++;
+    }
+    isFixed[slot] = false;
+}
+
+std::list<std::pair<NoteTuning, EPitch>> PairQueue::pairs(const Tuning& fixed) const {
+    unsigned int n = pitches.size();
+
+    int bestFixed = -1;
+    for (unsigned int t = 0; t < n; t++) {
+        if (!isFixed[t]) bestFixed = std::max(bestFixed, best[t]);
+    }
+    int bestVar = -1;
+    unsigned int bestLevel = weights.size();
+    while (bestLevel-- > 0) {
+        if (totals[bestLevel] > 0) {
+            bestVar = weights[bestLevel];
+            break;
+        }
+    }
+
+    std::list<std::pair<NoteTuning, EPitch>> bestPairs;
+    if (bestFixed > bestVar || bestFixed == intervals.weight(EPitch{Pitch::C, 4}, EPitch{Pitch::C, 4})) {
+		// Between variable pitches with the best weight, the lowest one
+        unsigned int slot = n;
+        for (unsigned int t = 0; t < n; t++) {
+            if (!isFixed[t] && best[t] == bestFixed && (slot == n || pitches[t] < pitches[slot])) slot = t;
+        }
+        const EPitch& pitch = pitches[slot];
+
+        for (const NoteTuning& nt : fixed) {
+            if (intervals.weight(nt.pitch, pitch) == bestFixed) {
+                bestPairs.emplace_back(std::pair<NoteTuning, EPitch>{nt, pitch});
+            }
+        }
+    } else {
+        for (unsigned int t = 0; t < n; t++) {
+            if (isFixed[t] || counts[t * weights.size() + bestLevel] == 0) continue;
+            for (const NoteTuning& nt : fixed) {
+                bestPairs.emplace_back(std::pair<NoteTuning, EPitch>{nt, pitches[t]});
+            }
+        }
+    }
+
+    return bestPairs;
+}
+
+std::pair<NoteTuning, EPitch> PairQueue::bestPair() const {
+    unsigned int n = pitches.size();
+    unsigned int slot = n;
+    for (unsigned int t = 0; t < n; t++) {
+        if (isFixed[t]) continue;
+        if (slot == n || best[t] > best[slot] || (best[t] == best[slot] && first[t] < first[slot])) slot = t;
+    }
+    return std::pair<NoteTuning, EPitch>{first[slot], pitches[slot]};
+}
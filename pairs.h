@@ -0,0 +1,74 @@
+#ifndef _PAIRS_H_
+#define _PAIRS_H_
+
+#include <array>
+#include <vector>
+#include <list>
+#include <utility>
+
+#include "pitch.h"
+#include "interval.h"
+#include "tunings.h"
+
+class PairQueue {
+	// Class that keeps track of the best pairs of pitches to check while
+	//   getValuesRec fixes the pitches of a chord one at a time, so that the
+	//   next pairs can be found without rescanning every pair of pitches.
+	//   Pairs of variable pitches are counted in buckets, one per distinct
+	//   weight in the interval table, and the best weight from each variable
+	//   pitch to a fixed pitch is kept up to date. Fixing a pitch updates both
+	//   in time linear in the size of the chord, and unfix undoes the last fix
+	//   when the recursion backtracks.
+    private:
+        const Interval& intervals;
+        std::vector<EPitch> pitches;
+
+		// Bucket of every interval (by number of semitones), and the weight
+		//   of every bucket in increasing order
+        std::array<unsigned int, 12> levels;
+        std::vector<int> weights;
+
+		// Number of pairs of variable pitches in every bucket, in total and
+		//   per pitch (pitches.size() rows of weights.size() counts)
+        std::vector<unsigned int> totals;
+        std::vector<unsigned int> counts;
+
+		// For every variable pitch, the best weight to a fixed pitch and the
+		//   smallest fixed NoteTuning with that weight
+        std::vector<bool> isFixed;
+        std::vector<int> best;
+        std::vector<NoteTuning> first;
+
+		// The pitches fixed so far, and the best weights they replaced
+        std::vector<unsigned int> fixedSlots;
+        std::vector<std::pair<int, NoteTuning>> saved;
+
+        unsigned int level(const EPitch& start, const EPitch& end) const;
+
+    public:
+		// Create a queue for the given fixed tuning and variable pitches,
+		//   using the weights of the given interval table
+        PairQueue(const Tuning& fixed, const std::vector<EPitch>& var, const Interval&);
+
+		// Move the pitch of the given NoteTuning from the variable pitches
+		//   to the fixed ones
+        void fix(const NoteTuning&);
+
+		// Undo the last call to fix
+        void unfix();
+
+		// Returns the pairs to check next given the current fixed tuning, the
+		//   same pairs as findPairsToCheck in the same order. Only the pairs
+		//   of the best bucket are built, in time linear in the size of the
+		//   chord and the number of pairs returned.
+        std::list<std::pair<NoteTuning, EPitch>> pairs(const Tuning& fixed) const;
+
+		// Returns the best pair between a fixed and a variable pitch: the
+		//   variable pitch with the largest weight to a fixed pitch (the first
+		//   one by the smallest fixed NoteTuning with that weight, if several
+		//   are tied) along with that NoteTuning. There must be at least one
+		//   fixed and one variable pitch.
+        std::pair<NoteTuning, EPitch> bestPair() const;
+};
+
+#endif
@@ -94,3 +94,79 @@ std::ostream& operator<<(std::ostream& out, const EPitchFreq& f) {
     out << "(" << f.pitch << " " << f.freq << ")";
     return out;
 }
+
+const EPitch* PitchSpan::begin() const {
+    return first;
+}
+
+const EPitch* PitchSpan::end() const {
+    return last;
+}
+
+unsigned int PitchSpan::size() const {
+    return last - first;
+}
+
+bool PitchSpan::empty() const {
+    return first == last;
+}
+
+FreqSpan::FreqIter::FreqIter(const EPitch* pitch, const double* freq): pitch{pitch}, freq{freq} {}
+
+FreqSpan::FreqIter& FreqSpan::FreqIter::operator++() {
+    ++pitch;
+    ++freq;
+    return *this;
+}
+
+EPitchFreq FreqSpan::FreqIter::operator*() const {
+    return EPitchFreq{*pitch, *freq};
+}
+
+bool FreqSpan::FreqIter::operator!=(const FreqSpan::FreqIter& other) const {
+    return pitch != other.pitch;
+}
+
+FreqSpan::FreqIter FreqSpan::begin() const {
+    return FreqIter{pitches, freqs};
+}
+
+FreqSpan::FreqIter FreqSpan::end() const {
+    return FreqIter{pitches + length, freqs + length};
+}
+
+unsigned int FreqSpan::size() const {
+    return length;
+}
+
+bool FreqSpan::empty() const {
+    return length == 0;
+}
+
+EPitchFreq FreqSpan::operator[](unsigned int i) const {
+    return EPitchFreq{pitches[i], freqs[i]};
+}
+
+PitchSpan FreqSpan::getPitches() const {
+    return PitchSpan{pitches, pitches + length};
+}
+
+unsigned int ChordSequence::size() const {
+    return length;
+}
+
+unsigned int ChordSequence::count(unsigned int i) const {
+    return counts ? counts[i] : 1;
+}
+
+PitchSpan ChordSequence::operator[](unsigned int i) const {
+    return PitchSpan{pitches + offsets[i], pitches + offsets[i + 1]};
+}
+
+PitchSpan ChordSequence::range(unsigned int i, unsigned int j) const {
+    return PitchSpan{pitches + offsets[i], pitches + offsets[j]};
+}
+
+ChordSequence ChordSequence::from(unsigned int i) const {
+    return ChordSequence{pitches, offsets + i, length - i, counts ? counts + i : nullptr};
+}
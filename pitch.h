@@ -23,6 +23,102 @@ struct EPitchFreq {
     double freq;
 };
 
+struct PitchSpan {
+	// Struct that represents a view of a contiguous range of EPitch objects,
+	//   such as one chord of a ChordSequence. The pitches are not owned by
+	//   the view, and must outlive it.
+    const EPitch* first;
+    const EPitch* last;
+
+	// Returns pointers to the first pitch and one past the last pitch, to
+	//   support range-based for loops
+    const EPitch* begin() const;
+    const EPitch* end() const;
+
+	// Returns the number of pitches in the range
+    unsigned int size() const;
+
+	// Returns true if the range contains no pitches, and false otherwise
+    bool empty() const;
+};
+
+struct FreqSpan {
+	// Struct that represents a view of a contiguous range of pitches and their
+	//   frequencies, stored as two parallel arrays, such as the pitches that
+	//   sound on one beat of a Score. Neither array is owned by the view, and
+	//   both must outlive it.
+    const EPitch* pitches;
+    const double* freqs;
+    unsigned int length;
+
+    class FreqIter {
+		// Iterator class for iterating over the pitches in the range
+        private:
+            const EPitch* pitch;
+            const double* freq;
+            FreqIter(const EPitch*, const double*);
+        public:
+			// Operators to support range-based for loops. Dereferencing the
+			//   iterator produces the current pitch with its frequency.
+            FreqSpan::FreqIter& operator++();
+            EPitchFreq operator*() const;
+            bool operator!=(const FreqSpan::FreqIter& other) const;
+
+        friend FreqSpan;
+    };
+
+	// Returns iterators to the first pitch and one past the last pitch, to
+	//   support range-based for loops
+    FreqIter begin() const;
+    FreqIter end() const;
+
+	// Returns the number of pitches in the range
+    unsigned int size() const;
+
+	// Returns true if the range contains no pitches, and false otherwise
+    bool empty() const;
+
+	// Returns pitch i with its frequency
+    EPitchFreq operator[](unsigned int i) const;
+
+	// Returns the pitches of the range, without their frequencies
+    PitchSpan getPitches() const;
+};
+
+struct ChordSequence {
+	// Struct that represents a view of a sequence of chords (collections of
+	//   simultaneous pitches) stored contiguously: the pitches of every chord
+	//   are stored one after another in pitches, and chord i consists of the
+	//   pitches from index offsets[i] up to (but not including) index
+	//   offsets[i + 1]. offsets must therefore have length + 1 entries. Neither
+	//   array is owned by the view, and both must outlive it.
+    const EPitch* pitches;
+    const unsigned int* offsets;
+    unsigned int length;
+
+	// If non-null, the number of consecutive beats that every chord lasts
+	//   (chord i lasts counts[i] beats, at least 1), so that a run of identical
+	//   beats can be passed as a single chord. The solvers tune every beat of
+	//   such a chord the same way. If null, every chord lasts one beat. Not
+	//   owned by the view either.
+    const unsigned int* counts = nullptr;
+
+	// Returns the number of chords in the sequence
+    unsigned int size() const;
+
+	// Returns the number of beats that chord i lasts
+    unsigned int count(unsigned int i) const;
+
+	// Returns the pitches of chord i
+    PitchSpan operator[](unsigned int i) const;
+
+	// Returns the pitches of chords i to j - 1, one chord after another
+    PitchSpan range(unsigned int i, unsigned int j) const;
+
+	// Returns a view of the chords from chord i onwards, without copying
+    ChordSequence from(unsigned int i) const;
+};
+
 // Returns true if the pitch on the left is lower than the pitch on the right, starting
 //   from C, and false otherwise
 bool operator<(Pitch, Pitch);
@@ -0,0 +1,60 @@
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include <unordered_set>
+#include <algorithm>
+
+#include "tunings.h"
+#include "hash.h"
+#include "pool.h"
+
+const uint32_t TuningPool::probe;
+
+const Tuning& TuningPool::Store::at(uint32_t id) const {
+    return id == probe ? *looking : tunings[id];
+}
+
+std::size_t TuningPool::IdHash::operator()(uint32_t id) const {
+    return Hash{}(store->at(id));
+}
+
+bool TuningPool::IdEqual::operator()(uint32_t a, uint32_t b) const {
+    return store->at(a) == store->at(b);
+}
+
+TuningPool::TuningPool(): store{new Store}, ids{0, IdHash{store.get()}, IdEqual{store.get()}} {}
+
+uint32_t TuningPool::intern(const Tuning& tuning) {
+    store->looking = &tuning;
+    auto find = ids.find(probe);
+    store->looking = nullptr;
+    if (find != ids.end()) return *find;
+    uint32_t id = store->tunings.size();
+    store->tunings.emplace_back(tuning);
+    ids.emplace(id);
+    return id;
+}
+
+const Tuning& TuningPool::get(uint32_t id) const {
+    return store->tunings[id];
+}
+
+bool TuningPool::less(uint32_t a, uint32_t b) const {
+    return store->tunings[a] < store->tunings[b];
+}
+
+void TuningPool::sort(std::vector<uint32_t>& ids) const {
+    std::stable_sort(ids.begin(), ids.end(), [this](uint32_t a, uint32_t b) {
+        return store->tunings[a] < store->tunings[b];
+    });
+}
+
+unsigned int TuningPool::size() const {
+    return store->tunings.size();
+}
+
+void TuningPool::clear() {
+    store->tunings.clear();
+    ids.clear();
+}
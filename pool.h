@@ -0,0 +1,79 @@
+#ifndef _POOL_H_
+#define _POOL_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include <unordered_set>
+
+#include "tunings.h"
+#include "hash.h"
+
+class TuningPool {
+	// Class that stores every distinct Tuning given to it exactly once and
+	//   identifies it by a 32-bit ID, so that the sequence solver can compare
+	//   tunings, keep sets of them and point back to them using integers. IDs
+	//   are assigned in order starting from 0, and stay valid for the lifetime
+	//   of the pool.
+    private:
+		// The Tunings by ID, and the Tuning that intern is looking up, which
+		//   ids refers to by the ID probe. They are kept behind a pointer so
+		//   that the hash and equality of ids still point to them after the
+		//   pool is moved.
+        struct Store {
+            std::vector<Tuning> tunings;
+            const Tuning* looking = nullptr;
+
+            const Tuning& at(uint32_t id) const;
+        };
+
+		// Hash and equality of IDs, which compare the Tunings they refer to
+        struct IdHash {
+            const Store* store;
+            std::size_t operator()(uint32_t id) const;
+        };
+        struct IdEqual {
+            const Store* store;
+            bool operator()(uint32_t a, uint32_t b) const;
+        };
+
+        static const uint32_t probe = UINT32_MAX;
+
+		// The set of IDs, which finds the ID of a Tuning without storing
+		//   the Tuning a second time as a key
+        std::unique_ptr<Store> store;
+        std::unordered_set<uint32_t, IdHash, IdEqual> ids;
+
+    public:
+		// Create an empty pool
+        TuningPool();
+
+		// Returns the ID of the given Tuning, adding it to the pool if an
+		//   equal Tuning has not been added before
+        uint32_t intern(const Tuning&);
+
+		// Returns the Tuning with the given ID, which must have been returned
+		//   by intern
+        const Tuning& get(uint32_t id) const;
+
+		// Returns true if the Tuning with the first ID is less than the
+		//   Tuning with the second ID (see the < operator for Tunings)
+        bool less(uint32_t a, uint32_t b) const;
+
+		// Orders the given IDs by their Tunings (see the < operator for
+		//   Tunings), keeping IDs with equal Tunings in the order given. Since
+		//   Frac comparisons are not consistent once ratios overflow, this uses
+		//   a merge sort, which only ever compares two of the IDs given and
+		//   stays within the vector even if the comparison is not a strict
+		//   weak ordering.
+        void sort(std::vector<uint32_t>& ids) const;
+
+		// Returns the number of distinct Tunings in the pool
+        unsigned int size() const;
+
+		// Remove every Tuning from the pool, invalidating every ID
+        void clear();
+};
+
+#endif
@@ -10,6 +10,7 @@
 
 #include "pitch.h"
 #include "receiver.h"
+#include "trace.h"
 
 
 const int BUFFER_SIZE = 256;
@@ -36,8 +37,11 @@ struct ReceiverImpl {
 	
 	void fillBuffers(int num, ALuint* buffer, float volume = 0.18) {
 		
+		Trace::Scope trace{"fillBuffers"};
 		ALshort data[BUFFER_SIZE];
+		Trace::Scope waiting{"fillBuffers: wait for lock"};
 		std::unique_lock<std::mutex> freqLock(freqMutex);
+		waiting.end();
 		
 		static long toneOffset = 0;
 		for (int b = 0; b < num; b++) {
@@ -56,6 +60,7 @@ struct ReceiverImpl {
 	void cycleBuffers() {
 		ALint freeBuffers = 0;
 		ALuint freeBuffer[NUM_BUFFERS]{};
+		Trace::nameThread("Receiver audio");
 		alSourcePlay(source);
 		while (true) {
 			alGetSourcei(source, AL_BUFFERS_PROCESSED, &freeBuffers);
@@ -103,7 +108,9 @@ Receiver::~Receiver() {
 }
 
 void Receiver::notify(const std::vector<EPitchFreq>& ep) {
+	Trace::Scope waiting{"notify: wait for lock"};
 	std::unique_lock<std::mutex> freqLock(imp->freqMutex);
+	waiting.end();
 	imp->freqs = ep;
 }
 
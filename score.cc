@@ -1,134 +1,434 @@
 #include <iostream>
+#include <cstdint>
 #include <vector>
 #include <map>
+#include <algorithm>
+#include <utility>
+#include <atomic>
+#include <thread>
+#include <future>
+#include <memory>
+#include <mutex>
 
 #include "pitch.h"
 #include "tunings.h"
 #include "score.h"
 #include "algo.h"
+#include "solver.h"
+#include "workers.h"
 
 
-Score::Score(): score{std::vector<std::map<EPitchFreq, bool>>{}}, notes{std::vector<std::list<EPitchFreq>>{}}, pitches{std::vector<std::list<EPitch>>{}} {}
+Score::Score(uint32_t resolution): resolution{std::max(resolution, 1u)}, events{}, length{0}, indexed{true}, pitches{}, offsets{0}, counts{}, starts{}, freqs{}, spans{} {}
+
+uint32_t Score::getResolution() const {
+    return resolution;
+}
 
 int Score::getLength() const {
-    return score.size();
+    return length;
 }
 
 Score& Score::add(const Note& note) {
+    if (note.duration < 0 || note.startBeat < 0) return *this;
     return add(note.pitch.pitch, note.duration, note.startBeat);
 }
 
+unsigned int Score::weight(uint32_t ticks) const {
+    return std::max(ticks / resolution, 1u);
+}
+
 Score& Score::add(const EPitch& pitch, uint32_t duration, uint32_t time) {
-    if (time + duration - 1 > score.size()) {
-        score.resize(time + duration - 1);
-        notes.resize(time + duration - 1);
-        pitches.resize(time + duration - 1);
+    if (time == 0 || duration == 0 || duration > UINT32_MAX - time) return *this;
+    events.emplace_back(Event{pitch, time, time + duration});
+    length = std::max(length, time + duration - 1);
+    indexed = false;
+    return *this;
+}
+
+// Returns a key that orders pitches the same way as operator<
+int pitchKey(const EPitch& pitch) {
+    return 12 * pitch.octave + static_cast<int>(pitch.pitch);
+}
+
+std::vector<unsigned int> Score::order() const {
+    std::vector<unsigned int> byStart(events.size());
+    for (unsigned int k = 0; k < events.size(); k++) byStart[k] = k;
+    auto earlier = [](const Event& a, const Event& b) {
+        return a.start < b.start;
+    };
+    if (std::is_sorted(events.begin(), events.end(), earlier)) return byStart;
+
+	// Radix sort on 16 bits of the start tick at a time
+    std::vector<unsigned int> sorted(events.size());
+    for (unsigned int shift : {0u, 16u}) {
+        if ((length + 1) >> shift == 0) break;
+        std::vector<unsigned int> bucket((1 << 16) + 1, 0);
+        for (unsigned int k : byStart) bucket[((events[k].start >> shift) & 0xffff) + 1]++;
+        for (unsigned int d = 1; d < bucket.size(); d++) bucket[d] += bucket[d - 1];
+        for (unsigned int k : byStart) sorted[bucket[(events[k].start >> shift) & 0xffff]++] = k;
+        byStart.swap(sorted);
     }
+    return byStart;
+}
 
-    for (uint32_t t = time; t < time + duration; t++) {
-        std::map<EPitchFreq, bool>& at = score[t - 1];
-        auto find = at.find(EPitchFreq{pitch, 0.0});
-        if (find != at.end()) {
-            at.emplace_hint(find, EPitchFreq{pitch, 0.0}, (t == time) || find->second);
-        } else {
-            at[EPitchFreq{pitch, 0.0}] = (t == time);
-            notes[t - 1].emplace_back(EPitchFreq{pitch, 0.0});
-            pitches[t - 1].emplace_back(pitch);
+void Score::index() const {
+    if (indexed) return;
+    pitches.clear();
+    offsets.assign(1, 0);
+    counts.clear();
+    starts.clear();
+    spans.clear();
+
+    std::vector<unsigned int> byStart = order();
+    pitches.reserve(events.size());
+    offsets.reserve(2 * events.size() + 1);
+    counts.reserve(2 * events.size());
+    starts.reserve(events.size());
+    spans.reserve(events.size());
+
+	// Sweep the events, keeping the events that sound during the current
+	//   segment, and the note every entry belongs to. The segment ends when
+	//   the next event starts or when an active event is released, whichever
+	//   comes first.
+    std::vector<unsigned int> active;
+    std::vector<std::pair<int, unsigned int>> sounding;
+    std::vector<unsigned int> noteOf;
+    auto nextStart = byStart.begin();
+    for (uint32_t t = 1; t <= length;) {
+        for (; nextStart != byStart.end() && events[*nextStart].start <= t; ++nextStart) active.emplace_back(*nextStart);
+        uint32_t next = length + 1;
+        if (nextStart != byStart.end()) next = events[*nextStart].start;
+        for (unsigned int a = 0; a < active.size();) {
+            if (events[active[a]].end <= t) {
+                active[a] = active.back();
+                active.pop_back();
+            } else {
+                next = std::min(next, events[active[a++]].end);
+            }
         }
+        unsigned int count = next - t;
+
+		// The entries of the segment are its distinct pitches, ordered by pitch
+        sounding.clear();
+        for (unsigned int k : active) sounding.emplace_back(pitchKey(events[k].pitch), k);
+        std::sort(sounding.begin(), sounding.end());
+        unsigned int first = offsets.back();
+        for (auto& entry : sounding) {
+            const Event& event = events[entry.second];
+            if (pitches.size() > first && pitches.back() == event.pitch) {
+                if (event.start == t) starts.back() = true;
+            } else {
+                pitches.emplace_back(event.pitch);
+                starts.push_back(event.start == t);
+            }
+        }
+        offsets.emplace_back(pitches.size());
+        counts.emplace_back(count);
+
+		// Entries that do not start a note continue the note of the same pitch
+		//   in the previous segment
+        unsigned int segment = counts.size() - 1;
+        noteOf.resize(pitches.size());
+        unsigned int prev = segment > 0 ? offsets[segment - 1] : 0;
+        for (unsigned int j = first; j < pitches.size(); j++) {
+            if (starts[j]) {
+                noteOf[j] = spans.size();
+                spans.emplace_back(Span{segment, j - first, static_cast<int>(t), static_cast<int>(count)});
+            } else {
+                while (pitchKey(pitches[prev]) < pitchKey(pitches[j])) prev++;
+                noteOf[j] = noteOf[prev];
+                spans[noteOf[j]].duration += count;
+            }
+        }
+        t = next;
     }
 
-    return *this;
+    freqs.assign(pitches.size(), 0.0);
+    indexed = true;
 }
 
 void Score::calculateFreqs() {
-    TuningSequence tuning = Algo::getTunings(std::list<std::list<EPitch>>{pitches.begin(), pitches.end()})[0];
-    std::vector<std::vector<EPitchFreq>> freqs = tuning.getFreqs();
+    calculateFreqs(Algo::Options{});
+}
+
+Algo::Stats Score::calculateFreqs(const Algo::Options& options, std::shared_ptr<Algo::SharedCache> shared) {
+    index();
+    if (length == 0) return Algo::Stats{};
 
-    // For now, assume the score has no breaks in it
-    for (unsigned int i = 0; i < freqs.size(); i++) {
-        std::map<EPitchFreq, bool>& mapAt = score[i];
-        std::list<EPitchFreq> newNotesAt;
+	// Every run of consecutive segments with the same pitches (e.g. a chord
+	//   struck on every beat) is solved as one chord that lasts the length of
+	//   the run
+    std::vector<EPitch> runPitches;
+    std::vector<unsigned int> runOffsets{0};
+    std::vector<unsigned int> runTicks;
+    for (unsigned int i = 0; i < counts.size(); i++) {
+        bool same = !runTicks.empty() && offsets[i + 1] - offsets[i] == offsets[i] - offsets[i - 1] &&
+            std::equal(pitches.begin() + offsets[i], pitches.begin() + offsets[i + 1], pitches.begin() + offsets[i - 1]);
+        if (same) {
+            runTicks.back() += counts[i];
+        } else {
+            runPitches.insert(runPitches.end(), pitches.begin() + offsets[i], pitches.begin() + offsets[i + 1]);
+            runOffsets.emplace_back(runPitches.size());
+            runTicks.emplace_back(counts[i]);
+        }
+    }
+    std::vector<unsigned int> runCounts;
+    for (unsigned int ticks : runTicks) runCounts.emplace_back(weight(ticks));
+
+    Algo::Solver solver{options, std::move(shared)};
+    setFreqs(solver.getTunings(ChordSequence{runPitches.data(), runOffsets.data(), static_cast<unsigned int>(runTicks.size()), runCounts.data()})[0], runTicks);
+    solver.publish();
+    return solver.getStats();
+}
+
+// Adds the disk cache lookups of a Solver to the given report
+static void addDiskStats(HierarchyReport& report, const Algo::Stats& stats) {
+    report.diskLookups += stats.diskLookups;
+    report.diskHits += stats.diskHits;
+    report.diskNanoseconds += stats.diskNanoseconds;
+}
 
-        for (EPitchFreq& ep : freqs[i]) {
-            auto nodeHandler = mapAt.extract(ep);
-            nodeHandler.key() = ep;
-            mapAt.insert(std::move(nodeHandler));
+HierarchyReport Score::calculateFreqs(const Algo::Options& options, const Hierarchy& hierarchy, std::shared_ptr<Algo::SharedCache> shared) {
+    index();
+    uint32_t span = std::max(hierarchy.span, 1u) * resolution;
+    unsigned int spans = (length + span - 1) / span;
+    HierarchyReport report{spans, length, 0, 0, 0};
+    if (length == 0) return report;
 
-            newNotesAt.emplace_back(ep);
+	// Cut the segments at the edges of the spans into pieces, and merge
+	//   consecutive pieces of a span with the same pitches. The pieces of span
+	//   k are pieces firsts[k] up to firsts[k + 1].
+    std::vector<EPitch> piecePitches;
+    std::vector<unsigned int> pieceOffsets{0};
+    std::vector<unsigned int> pieceTicks;
+    std::vector<unsigned int> firsts{0};
+    uint32_t t = 0;
+    for (unsigned int i = 0; i < counts.size(); i++) {
+        for (uint32_t end = t + counts[i]; t < end;) {
+            uint32_t cut = std::min(end, (t / span + 1) * span);
+            bool same = pieceTicks.size() > firsts.back() && offsets[i + 1] - offsets[i] == pieceOffsets.back() - pieceOffsets[pieceOffsets.size() - 2] &&
+                std::equal(pitches.begin() + offsets[i], pitches.begin() + offsets[i + 1], piecePitches.end() - (offsets[i + 1] - offsets[i]));
+            if (same) {
+                pieceTicks.back() += cut - t;
+            } else {
+                piecePitches.insert(piecePitches.end(), pitches.begin() + offsets[i], pitches.begin() + offsets[i + 1]);
+                pieceOffsets.emplace_back(piecePitches.size());
+                pieceTicks.emplace_back(cut - t);
+            }
+            if (cut % span == 0) firsts.emplace_back(pieceTicks.size());
+            t = cut;
         }
+    }
+    if (firsts.size() == spans) firsts.emplace_back(pieceTicks.size());
+    std::vector<unsigned int> pieceCounts;
+    for (unsigned int ticks : pieceTicks) pieceCounts.emplace_back(weight(ticks));
+
+	// Merge every span into the pitches that sound for more than half of it
+	//   (or, if there are none, the one that sounds for the longest)
+    std::vector<EPitch> coarsePitches;
+    std::vector<unsigned int> coarseOffsets{0};
+    for (unsigned int k = 0; k < spans; k++) {
+        std::vector<std::pair<EPitch, unsigned int>> counts;
+        for (unsigned int i = firsts[k]; i < firsts[k + 1]; i++) {
+            for (unsigned int j = pieceOffsets[i]; j < pieceOffsets[i + 1]; j++) {
+                auto find = std::find_if(counts.begin(), counts.end(), [&](const std::pair<EPitch, unsigned int>& count) {
+                    return count.first == piecePitches[j];
+                });
+                if (find == counts.end()) counts.emplace_back(piecePitches[j], pieceTicks[i]);
+                else find->second += pieceTicks[i];
+            }
+        }
+        std::stable_sort(counts.begin(), counts.end(), [](const std::pair<EPitch, unsigned int>& a, const std::pair<EPitch, unsigned int>& b) {
+            return a.second > b.second;
+        });
+        unsigned int kept = 1;
+        while (kept < std::min<unsigned int>(counts.size(), hierarchy.pitches) && 2 * counts[kept].second > span) kept++;
+        if (counts.size() > kept) counts.resize(kept);
+        for (auto& count : counts) coarsePitches.emplace_back(count.first);
+        coarseOffsets.emplace_back(coarsePitches.size());
+    }
+
+    Algo::Solver coarseSolver{options, shared};
+    TuningSequence coarseTuning = coarseSolver.getTunings(ChordSequence{coarsePitches.data(), coarseOffsets.data(), spans})[0];
+    coarseSolver.publish();
+    addDiskStats(report, coarseSolver.getStats());
+    std::vector<Tuning> coarse;
+    for (const Tuning& tuning : coarseTuning) coarse.emplace_back(tuning);
+
+	// Re-solve the pieces of every span after the coarse tuning of the span
+	//   before it. Starting from the coarse tuning of the span itself would
+	//   tie its pitches to that tuning through their unisons, so the fine pass
+	//   could never depart from it. The spans are independent, so they are
+	//   shared out between threads, each with its own Solver so that spans
+	//   with the same chords reuse its expansions.
+    Algo::Options fineOptions{options};
+    fineOptions.trim = hierarchy.band;
+    ChordSequence seq{piecePitches.data(), pieceOffsets.data(), static_cast<unsigned int>(pieceTicks.size()), pieceCounts.data()};
+    std::vector<TuningSequence> fine(spans);
+    std::atomic<unsigned int> next{0};
+    std::mutex reportMutex;
+    auto work = [&]() {
+        Algo::Solver solver{fineOptions, shared};
+        for (unsigned int k = next++; k < spans; k = next++) {
+            ChordSequence spanSeq = seq.from(firsts[k]);
+            spanSeq.length = firsts[k + 1] - firsts[k];
+            fine[k] = k == 0 ? solver.getTunings(spanSeq)[0] : solver.getTuningsAfter(coarse[k - 1], spanSeq)[0];
+        }
+        solver.publish();
+        std::lock_guard<std::mutex> lock(reportMutex);
+        addDiskStats(report, solver.getStats());
+    };
+    if (hierarchy.workers) {
+        hierarchy.workers->forEach(std::min(hierarchy.workers->size(), spans), [&](unsigned int) { work(); });
+    } else {
+        unsigned int workers = std::max(1u, std::min(std::thread::hardware_concurrency(), spans));
+        std::vector<std::future<void>> futures;
+        for (unsigned int w = 1; w < workers; w++) {
+            futures.emplace_back(std::async(std::launch::async, work));
+        }
+        work();
+        for (std::future<void>& future : futures) future.get();
+    }
 
-        notes[i] = newNotesAt;
+    TuningSequence tuning;
+    unsigned int piece = 0;
+    for (unsigned int k = 0; k < spans; k++) {
+        for (const Tuning& chord : fine[k]) {
+            bool departed = false;
+            for (const NoteTuning& nt : chord) {
+                for (const NoteTuning& c : coarse[k]) {
+                    if (!(c.pitch == nt.pitch)) continue;
+                    report.notes += pieceTicks[piece];
+                    if (!(c.tuning == nt.tuning)) {
+                        report.departedNotes += pieceTicks[piece];
+                        departed = true;
+                    }
+                }
+            }
+            if (departed) report.departedBeats += pieceTicks[piece];
+            tuning.addTuning(chord);
+            piece++;
+        }
     }
+
+    setFreqs(tuning, pieceTicks);
+    return report;
 }
 
-Score::BeatIter::BeatIter(std::vector<std::list<EPitchFreq>>::const_iterator it): it{it} {}
+void Score::setFreqs(const TuningSequence& tuning, const std::vector<unsigned int>& lengths) {
+    std::vector<EPitchFreq> pieceFreqs;
+    std::vector<unsigned int> pieceOffsets;
+    tuning.getFreqs(pieceFreqs, pieceOffsets);
+    unsigned int pieces = pieceOffsets.size() - 1;
+
+	// Rebuild the index, cutting every segment at the edges of the pieces,
+	//   and merging the consecutive cuts of a segment that are tuned the same
+	//   way
+    std::vector<EPitch> newPitches;
+    std::vector<unsigned int> newOffsets{0};
+    std::vector<unsigned int> newCounts;
+    std::vector<bool> newStarts;
+    std::vector<double> newFreqs;
+    std::vector<unsigned int> firsts;
+    std::vector<double> at;
+    unsigned int piece = 0;
+    uint32_t t = 0;
+    uint32_t pieceEnd = lengths.empty() ? 0 : lengths[0];
+    for (unsigned int i = 0; i < counts.size(); i++) {
+        firsts.emplace_back(newCounts.size());
+        bool first = true;
+        for (uint32_t end = t + counts[i]; t < end;) {
+            while (piece < pieces && pieceEnd <= t) {
+                piece++;
+                if (piece < lengths.size()) pieceEnd += lengths[piece];
+            }
+            uint32_t cut = piece < pieces ? std::min(end, pieceEnd) : end;
+
+            at.assign(freqs.begin() + offsets[i], freqs.begin() + offsets[i + 1]);
+            // For now, assume the score has no breaks in it
+            if (piece < pieces) {
+                for (unsigned int p = pieceOffsets[piece]; p < pieceOffsets[piece + 1]; p++) {
+                    for (unsigned int j = offsets[i]; j < offsets[i + 1]; j++) {
+                        if (pitches[j] == pieceFreqs[p].pitch) at[j - offsets[i]] = pieceFreqs[p].freq;
+                    }
+                }
+            }
+
+            if (!first && std::equal(at.begin(), at.end(), newFreqs.end() - at.size())) {
+                newCounts.back() += cut - t;
+            } else {
+                newPitches.insert(newPitches.end(), pitches.begin() + offsets[i], pitches.begin() + offsets[i + 1]);
+                newOffsets.emplace_back(newPitches.size());
+                newCounts.emplace_back(cut - t);
+                for (unsigned int j = offsets[i]; j < offsets[i + 1]; j++) newStarts.push_back(first && starts[j]);
+                newFreqs.insert(newFreqs.end(), at.begin(), at.end());
+            }
+            first = false;
+            t = cut;
+        }
+    }
+
+    for (Span& span : spans) span.segment = firsts[span.segment];
+    pitches.swap(newPitches);
+    offsets.swap(newOffsets);
+    counts.swap(newCounts);
+    starts.swap(newStarts);
+    freqs.swap(newFreqs);
+}
+
+Score::BeatIter::BeatIter(const Score* score, unsigned int segment): score{score}, segment{segment}, beat{0} {}
 
 Score::BeatIter& Score::BeatIter::operator++() {
-    ++it;
+    if (++beat == score->counts[segment]) {
+        ++segment;
+        beat = 0;
+    }
     return *this;
 }
 
-std::list<EPitchFreq> Score::BeatIter::operator*() const {
-    return *it;
+FreqSpan Score::BeatIter::operator*() const {
+    unsigned int first = score->offsets[segment];
+    return FreqSpan{score->pitches.data() + first, score->freqs.data() + first, score->offsets[segment + 1] - first};
 }
 
 bool Score::BeatIter::operator!=(const Score::BeatIter& other) const {
-    return it != other.it;
+    return segment != other.segment || beat != other.beat;
 }
 
 Score::BeatIter Score::begin() const {
-    return Score::BeatIter{notes.begin()};
+    index();
+    return Score::BeatIter{this, 0};
 }
 
 Score::BeatIter Score::end() const {
-    return Score::BeatIter{notes.end()};
+    index();
+    return Score::BeatIter{this, static_cast<unsigned int>(counts.size())};
 }
 
-Score::NoteIter::NoteIter(std::vector<std::map<EPitchFreq, bool>>::const_iterator begin, std::vector<std::map<EPitchFreq, bool>>::const_iterator end): begin{begin}, end{end}, beat{1} {
-    if (begin != end) {
-        it = (*begin).begin();
-    } else {
-        it = (*begin).end();
-    }
-}
+Score::NoteIter::NoteIter(const Score* score, unsigned int note): score{score}, note{note} {}
 
 Score::NoteIter& Score::NoteIter::operator++() {
-    do {
-        ++it;
-        if (it == (*begin).end()) {
-            if (begin == end) return *this;
-            ++begin;
-            ++beat;
-            it = (*begin).begin();
-        }
-    } while (!(*it).second);
-
+    ++note;
     return *this;
 }
 
 Note Score::NoteIter::operator*() const {
-    int duration = 1;
-    auto beginCopy{begin + 1};
-    const EPitchFreq& pitch = it->first;
-    while (beginCopy <= end) {
-        auto find = (*beginCopy).find(pitch);
-        if ((find != (*beginCopy).end()) && !find->second) {
-            duration++;
-            ++beginCopy;
-        } else break;
-    }
-    return Note{pitch, duration, beat};
+    const Span& span = score->spans[note];
+    unsigned int entry = score->offsets[span.segment] + span.entry;
+    return Note{EPitchFreq{score->pitches[entry], score->freqs[entry]}, span.duration, span.beat};
 }
 
 bool Score::NoteIter::operator!=(const Score::NoteIter& other) const {
-    return (begin != other.begin) || (it != other.it);
+    return note != other.note;
 }
 
 Score::NoteIter Score::nbegin() const {
-    return Score::NoteIter{score.begin(), score.end() - 1};
+    index();
+    return Score::NoteIter{this, 0};
 }
 
 Score::NoteIter Score::nend() const {
-    return Score::NoteIter{score.end() - 1, score.end() - 1};
+    index();
+    return Score::NoteIter{this, static_cast<unsigned int>(spans.size())};
 }
 
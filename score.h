@@ -2,45 +2,165 @@
 #define _SCORE_H_
 
 #include <vector>
-#include <list>
-#include <map>
+#include <cstdint>
+#include <memory>
 
 #include "pitch.h"
 
+class TuningSequence;
+class Workers;
+
+namespace Algo {
+    struct Options;
+    struct Stats;
+    class SharedCache;
+}
+
 struct Note {
 	// Struct that packages a pitch frequency, the duration of that
-	//   frequency, and the start beat of that frequency
+	//   frequency, and the start beat of that frequency. The duration and the
+	//   start beat are measured in ticks of the score (see Score).
     const EPitchFreq pitch;
     int duration;
     int startBeat;
 };
 
+struct Hierarchy {
+	// Struct that packages the parameters of a hierarchical solve (see
+	//   Score::calculateFreqs): the number of consecutive beats merged into
+	//   each coarse chord, the largest number of pitches kept in a coarse
+	//   chord, and the number of tunings the fine pass keeps after every chord.
+	//   A coarse chord is made of the pitches that sound for more than half of
+	//   its span, most sounding first.
+	// The spans of the fine pass are solved as tasks of the given Workers, if
+	//   any, and otherwise on threads started for the solve.
+    unsigned int span = 4;
+    unsigned int pitches = 6;
+    unsigned int band = 2;
+    Workers* workers = nullptr;
+};
+
+struct HierarchyReport {
+	// Struct that packages the outcome of a hierarchical solve: the number of
+	//   coarse chords solved, the number of beats re-solved by the fine pass,
+	//   and how many of those beats (and of their notes) were tuned differently
+	//   from the coarse solution. Only notes whose pitch is in the coarse chord
+	//   of their span are compared. The beats are counted in ticks, so they
+	//   are beats at the default resolution.
+	// It also sums the lookups its Solvers made in the DiskCache of their
+	//   shared cache, if any (see Algo::Stats).
+    unsigned int spans;
+    unsigned int beats;
+    unsigned int departedBeats;
+    unsigned int notes;
+    unsigned int departedNotes;
+    unsigned long diskLookups = 0;
+    unsigned long diskHits = 0;
+    unsigned long diskNanoseconds = 0;
+};
+
 class Score {
 	// Class that represents a musical score and uses the algorithms in
 	//   this project to optimize how pitches in the score are tuned.
 	//   Also provides iterators to iterate over the beats or the notes
 	//   in the score.
+	// Times in a score are measured in ticks, and every beat is divided into
+	//   the same number of ticks (the resolution of the score), so that notes
+	//   can start and end on subdivisions of a beat. By default a beat is a
+	//   single tick, and the ticks and the beats are the same.
+	// The score stores the notes added to it as events. The beats are indexed
+	//   from the events the first time they are needed after a note is added,
+	//   as segments: runs of consecutive ticks on which no note starts or is
+	//   released. A segment is stored once however many ticks it lasts, so
+	//   the memory used grows with the number of notes rather than their
+	//   durations or the resolution.
 
     private:
-        std::vector<std::map<EPitchFreq, bool>> score;
-        std::vector<std::list<EPitchFreq>> notes;
-        std::vector<std::list<EPitch>> pitches;
+		// The number of ticks in a beat
+        uint32_t resolution;
+
+		// The notes added to the score, in the order they were added: their
+		//   pitch, the tick they start on and the tick they are released on
+        struct Event {
+            EPitch pitch;
+            uint32_t start;
+            uint32_t end;
+        };
+        std::vector<Event> events;
+        uint32_t length;
+
+		// Index of the events, rebuilt by index when notes were added since it
+		//   was last built. The pitches sounding during every segment are
+		//   stored contiguously, ordered by pitch, so that the segments can be
+		//   passed to the solver as a ChordSequence: the pitches of segment i
+		//   are pitches[offsets[i]] up to pitches[offsets[i + 1]], and it lasts
+		//   counts[i] ticks. Each of those entries also has a frequency, and a
+		//   flag that is set if a note of that pitch starts on the first tick
+		//   of the segment.
+        mutable bool indexed;
+        mutable std::vector<EPitch> pitches;
+        mutable std::vector<unsigned int> offsets;
+        mutable std::vector<unsigned int> counts;
+        mutable std::vector<bool> starts;
+        mutable std::vector<double> freqs;
+
+		// The notes of the score in the order they are iterated: the segment
+		//   they start in, the position of their entry in that segment, the tick
+		//   they start on and their duration. A note that starts while its
+		//   pitch is already sounding cuts the earlier note short, and lasts
+		//   for as long as either of them would have.
+        struct Span {
+            unsigned int segment;
+            unsigned int entry;
+            int beat;
+            int duration;
+        };
+        mutable std::vector<Span> spans;
+
+		// Returns the indices of the events in order of their start ticks,
+		//   keeping events that start together in the order they were added.
+		//   Unless they were added in that order already, they are sorted
+		//   with a radix sort.
+        std::vector<unsigned int> order() const;
+
+		// Builds the index of the events if it is out of date. Sweeps the
+		//   events in order of their start ticks (see order), so it takes time
+		//   proportional to the number of entries plus the number of events.
+        void index() const;
+
+		// Returns the weight of a chord lasting the given number of ticks in a
+		//   solve: the number of whole beats it lasts, and at least 1
+        unsigned int weight(uint32_t ticks) const;
+
+		// Sets the frequencies of the score from the given TuningSequence,
+		//   which has one Tuning per piece of the score, where piece i lasts
+		//   lengths[i] ticks. A segment whose ticks are tuned differently is
+		//   split into segments that are tuned the same way.
+        void setFreqs(const TuningSequence&, const std::vector<unsigned int>& lengths);
 
     public:
-		// Create an empty Score
-        Score();
+		// Create an empty Score with the given number of ticks in a beat
+        explicit Score(uint32_t resolution = 1);
+
+		// Returns the number of ticks in a beat of the Score
+        uint32_t getResolution() const;
 
-		// Get the length of the Score. The length of the score is the
-		//   beat on which the last note is released, minus 1.
+		// Get the length of the Score in ticks. The length of the score is
+		//   the tick on which the last note is released, minus 1.
         int getLength() const;
 
 		// Add a note to the score. The frequency field of the note's
-		//   EPitchFreq object is ignored. Returns itself for chaining.
+		//   EPitchFreq object is ignored. A note with a negative duration or
+		//   start tick is ignored, as are the notes the method below ignores.
+		//   Returns itself for chaining.
         Score& add(const Note&);
 		
 		// Add a pitch to the score with the specified duration and start
-		//   beat. Returns itself for chaining.
-        Score& add(const EPitch&, uint32_t duration, uint32_t beat);
+		//   tick. Ticks are counted from 1 (as in readScore), so a note that
+		//   starts at tick 0 is ignored, as is a note that lasts no ticks, or
+		//   that would be released after the last tick a score can hold.
+		//   Returns itself for chaining.
+        Score& add(const EPitch&, uint32_t duration, uint32_t tick);
 
 		// Internally calculates the optimal frequencies of the pitches
 		//   in the score. This method must be called before any iterators
@@ -49,16 +169,44 @@ class Score {
 		//   before instantiating iterators.
         void calculateFreqs();
 
+		// Same as above, but the frequencies are calculated with the given
+		//   solver options (see Algo::Options), e.g. to trade the quality of
+		//   the tuning for speed. The chords solved are the runs of ticks
+		//   between the points where the pitches sounding change, so the time
+		//   taken grows with the number of changes of harmony rather than the
+		//   number of beats or the resolution. A chord that lasts several beats,
+		//   such as a held chord, is tuned the same way throughout and counts
+		//   once for every whole beat it lasts. Returns the counters of the
+		//   solve (see Algo::Stats), including how many chords were replayed
+		//   from repeated passages of the score rather than solved again.
+		//   If shared is non-null, the solve looks expansions up in it (see
+		//   Algo::SharedCache) and publishes the expansions it found to it, so
+		//   that scores solved with the same cache reuse each other's work.
+		//   An empty score has nothing to solve, and returns no counters.
+        Algo::Stats calculateFreqs(const Algo::Options&, std::shared_ptr<Algo::SharedCache> shared = nullptr);
+
+		// Same as above, but solves the score hierarchically, which is much
+		//   faster for long or dense scores. First, a coarse sequence with one
+		//   chord per span of beats is solved. Then the chords of every span
+		//   (as above, cut at the edges of the span) are re-solved
+		//   (concurrently) after the coarse tuning of the span before it,
+		//   keeping only a narrow band of tunings after every chord.
+		//   The tuning found may be worse than the one found by a full solve.
+		//   Returns how often the fine pass departed from the coarse solution.
+        HierarchyReport calculateFreqs(const Algo::Options&, const Hierarchy&, std::shared_ptr<Algo::SharedCache> shared = nullptr);
+
         class BeatIter {
 			// Iterator class for iterating over beats in the score
             private:
-                std::vector<std::list<EPitchFreq>>::const_iterator it;
-                BeatIter(std::vector<std::list<EPitchFreq>>::const_iterator);
+                const Score* score;
+                unsigned int segment;
+                unsigned int beat;
+                BeatIter(const Score*, unsigned int);
             public:
 				// Operators to support range-based for loops. See below for
 				//   documentation
                 Score::BeatIter& operator++();
-                std::list<EPitchFreq> operator*() const;
+                FreqSpan operator*() const;
                 bool operator!=(const Score::BeatIter& other) const;
 
             friend Score;
@@ -67,11 +215,9 @@ class Score {
         class NoteIter {
 			// Iterator class for iterating over notes in the score
             private:
-                std::vector<std::map<EPitchFreq, bool>>::const_iterator begin;
-                const std::vector<std::map<EPitchFreq, bool>>::const_iterator end;
-                std::map<EPitchFreq, bool>::const_iterator it;
-                int beat;
-                NoteIter(std::vector<std::map<EPitchFreq, bool>>::const_iterator, std::vector<std::map<EPitchFreq, bool>>::const_iterator);
+                const Score* score;
+                unsigned int note;
+                NoteIter(const Score*, unsigned int);
             public:
 				// Operators to support range-based for loops. See below for
 				//   documentation
@@ -82,11 +228,13 @@ class Score {
             friend Score;
         };
 
-		// Create an iterator that iterates over every beat in the score.
-		//   Dereferencing the iterator will produce a list of EPitchFreq
-		//   objects representing the pitch frequencies at that beat (possibly
-		//   empty).
-		//   Incrementing the iterator will increment the beat.
+		// Create an iterator that iterates over every tick in the score (every
+		//   beat, at the default resolution).
+		//   Dereferencing the iterator will produce a view of the pitches that
+		//   sound on that tick with their frequencies (possibly empty), ordered
+		//   by pitch. The view points into the Score, so it copies nothing, and
+		//   it is valid until the Score is next changed or solved.
+		//   Incrementing the iterator will increment the tick.
         BeatIter begin() const;
 		
 		// End condition for iteration. Compare this to an iterator using
@@ -97,9 +245,8 @@ class Score {
 		//   Dereferencing the iterator will produce a Note object containing
 		//   data for that note.
 		//   Incrementing the iterator will produce a new iterator with the
-		//   next note. The notes should not be assumed to be in any particular
-		//   order, but (of course) it is guaranteed that every note will
-		//   be reached before the end condition is reached.
+		//   next note. The notes are ordered by the tick they start on, and
+		//   notes that start on the same tick are ordered by pitch.
         NoteIter nbegin() const;
 		
 		// End condition for iteration. Compare this to an iterator using
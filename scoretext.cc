@@ -0,0 +1,136 @@
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <utility>
+#include <algorithm>
+
+#include "pitch.h"
+#include "score.h"
+#include "mapped.h"
+#include "scoretext.h"
+
+///////////////////////////////////////////////////////////////
+// Parsing helpers
+
+struct TextReader {
+	// Cursor over the characters of a text score; every parse returns false
+	//   instead of reading past the end
+    const char* at;
+    const char* end;
+
+	// Skips spaces and tabs (and the carriage returns of CRLF line endings),
+	//   returning true if any were skipped
+    bool blanks() {
+        const char* start = at;
+        while (at != end && (*at == ' ' || *at == '\t' || *at == '\r')) at++;
+        return at != start;
+    }
+
+	// Skips a comment, if any, and returns true if the line ends here
+    bool lineEnd() {
+        if (at != end && *at == '#') {
+            const char* newline = static_cast<const char*>(std::memchr(at, '\n', end - at));
+            at = newline ? newline : end;
+        }
+        return at == end || *at == '\n';
+    }
+
+    bool number(int32_t& n, bool sign = false) {
+        bool negative = sign && at != end && *at == '-';
+        if (negative) at++;
+        if (at == end || *at < '0' || *at > '9') return false;
+        int64_t value = 0;
+        while (at != end && *at >= '0' && *at <= '9') {
+            value = 10 * value + (*at++ - '0');
+            if (value > INT32_MAX) return false;
+        }
+        n = static_cast<int32_t>(negative ? -value : value);
+        return true;
+    }
+
+    bool pitch(EPitch& pitch) {
+        static const int letters[7] = {9, 11, 0, 2, 4, 5, 7};
+        if (at == end || *at < 'A' || *at > 'G') return false;
+        int p = letters[*at++ - 'A'];
+        if (at != end && *at == 's') {
+			// Only the sharps that operator<< writes, so E and B have none
+            if (p == 4 || p == 11) return false;
+            p++;
+            at++;
+        }
+        int32_t octave;
+        if (at == end || *at++ != '-' || !number(octave, true)) return false;
+        pitch = EPitch{static_cast<Pitch>(p), octave};
+        return true;
+    }
+
+    bool keyword(const char* word) {
+        std::size_t length = std::strlen(word);
+        if (static_cast<std::size_t>(end - at) < length || std::memcmp(at, word, length) != 0) return false;
+        at += length;
+        return true;
+    }
+};
+
+///////////////////////////////////////////////////////////////
+
+bool readScore(const char* data, std::size_t size, Score& score) {
+    TextReader text{data, data + size};
+    Score read;
+    bool noted = false;
+
+    for (; text.at != text.end; text.at++) {
+        text.blanks();
+        if (text.lineEnd()) {
+            if (text.at == text.end) break;
+            continue;
+        }
+
+        if (text.keyword("resolution")) {
+            int32_t resolution;
+            if (noted || !text.blanks() || !text.number(resolution) || resolution < 1) return false;
+            text.blanks();
+            if (!text.lineEnd()) return false;
+            read = Score{static_cast<uint32_t>(resolution)};
+            if (text.at == text.end) break;
+            continue;
+        }
+
+        EPitch pitch;
+        int32_t duration, start;
+        if (!text.pitch(pitch) || !text.blanks() || !text.number(duration) || !text.blanks() || !text.number(start)) return false;
+        text.blanks();
+        if (!text.lineEnd() || duration < 1 || start < 1) return false;
+        read.add(pitch, duration, start);
+        noted = true;
+        if (text.at == text.end) break;
+    }
+    score = std::move(read);
+    return true;
+}
+
+bool readScore(const std::string& name, Score& score) {
+    MappedFile file;
+    if (!file.open(name, true)) {
+		// An empty file is an empty score, but cannot be mapped
+        std::ifstream in{name};
+        if (!in || in.peek() != std::ifstream::traits_type::eof()) return false;
+        score = Score{};
+        return true;
+    }
+    return readScore(reinterpret_cast<const char*>(file.data()), file.size(), score);
+}
+
+bool writeScore(const std::string& name, const Score& score) {
+    std::ofstream out{name};
+    if (!out) return false;
+    out << "resolution " << score.getResolution() << "\n";
+    for (auto it = score.nbegin(); it != score.nend(); ++it) {
+        Note note = *it;
+        out << note.pitch.pitch << " " << note.duration << " " << note.startBeat << "\n";
+    }
+    out.flush();
+    return static_cast<bool>(out);
+}
@@ -0,0 +1,38 @@
+#ifndef _SCORETEXT_H_
+#define _SCORETEXT_H_
+
+#include <cstddef>
+#include <string>
+
+class Score;
+
+// Reads the text score with the given name into the given score, replacing
+//   its contents. A text score has one note per line: its pitch, written as
+//   operator<< writes an EPitch (e.g. Cs-5, or C--1 for octave -1), its
+//   duration and the tick it starts on (see Note), separated by spaces or
+//   tabs, e.g.
+//       # the first bar of the sample song
+//       resolution 1
+//       B-4 1 1
+//       Cs-5 2 5
+//   Text from a # to the end of its line is a comment, and blank lines are
+//   skipped. An optional resolution line before the first note sets the
+//   resolution of the score (1 by default). The file is memory-mapped and
+//   parsed where it is, and every note is added to the score as it is
+//   parsed, so nothing is allocated per token.
+//   Returns true if the file was read, and false if it could not be opened
+//   or has a malformed line, a duration or start tick below 1, or a
+//   resolution line after a note (in which case the score is left
+//   unmodified).
+bool readScore(const std::string& file, Score&);
+
+// Same as above, but reads the text score from the given number of bytes in
+//   memory
+bool readScore(const char* data, std::size_t size, Score&);
+
+// Writes the notes of the given score to a text score with the given name,
+//   in the order of Score::NoteIter, with a resolution line. Returns true if
+//   the file was written.
+bool writeScore(const std::string& file, const Score&);
+
+#endif
@@ -0,0 +1,750 @@
+#include <vector>
+#include <list>
+#include <map>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <utility>
+#include <algorithm>
+#include <functional>
+#include <chrono>
+
+#include "frac.h"
+#include "pitch.h"
+#include "interval.h"
+#include "tunings.h"
+#include "hash.h"
+#include "algo.h"
+#include "checkpoint.h"
+#include "pool.h"
+#include "solver.h"
+#include "diskcache.h"
+#include "counters.h"
+
+#if defined(DATATUNE_COUNTERS)
+thread_local Algo::Counters* Algo::counting = nullptr;
+#endif
+
+// Helpers defined in algo.cc
+std::multimap<int, Tuning> byValue(const std::map<Tuning, int>& m);
+std::vector<Tuning> bestOf(const std::multimap<int, Tuning>& mm);
+std::vector<std::vector<Tuning>> bestOfEach(const std::map<Tuning, std::vector<int>>& m, unsigned int profiles);
+void checkProfiles(const std::vector<Interval>& profiles);
+
+Algo::SharedCache::SharedCache(const Options& options, std::shared_ptr<const DiskCache> disk): options{options}, disk{}, mutex{}, entries{} {
+    if (disk && sameSearch(disk->getOptions(), options)) {
+        this->disk = std::move(disk);
+    }
+}
+
+const Algo::Options& Algo::SharedCache::getOptions() const {
+    return options;
+}
+
+const Algo::DiskCache* Algo::SharedCache::getDisk() const {
+    return disk.get();
+}
+
+bool Algo::SharedCache::find(const Tuning& normal, const std::vector<EPitch>& chord, std::vector<std::pair<Tuning, int>>& expansions) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    auto find = entries.find(normal);
+    if (find == entries.end()) return false;
+    auto chordFind = find->second.find(chord);
+    if (chordFind == find->second.end()) return false;
+    expansions = chordFind->second;
+    return true;
+}
+
+void Algo::SharedCache::insert(const Tuning& normal, const std::vector<EPitch>& chord, const std::vector<std::pair<Tuning, int>>& expansions) {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    entries[normal].emplace(chord, expansions);
+}
+
+unsigned int Algo::SharedCache::size() const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    unsigned int n = 0;
+    for (auto& entry : entries) n += entry.second.size();
+    return n;
+}
+
+void Algo::SharedCache::forEach(const std::function<void(const Tuning&, const std::vector<EPitch>&, const std::vector<std::pair<Tuning, int>>&)>& f) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    for (auto& entry : entries) {
+        for (auto& chord : entry.second) f(entry.first, chord.first, chord.second);
+    }
+}
+
+void Algo::SharedCache::clear() {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    entries.clear();
+}
+
+// Returns every optimal TuningSequence through the chords consumed by the given
+//   state (whose tunings are in the given pool), following its back-pointer
+//   maps from the best tunings of its frontier, and sets value to their value
+std::vector<TuningSequence> backtrack(const SolveState& state, const TuningPool& pool, int& value) {
+    std::vector<std::list<uint32_t>> v;
+    auto rit = state.frontier.rbegin();
+    int bestValue = (*rit).first;
+    while ((rit != state.frontier.rend()) && (*rit).first == bestValue) {
+        v.emplace_back(std::list<uint32_t>{(*rit).second});
+        ++rit;
+    }
+    value = bestValue;
+
+    for (auto backMap = state.backMaps.rbegin(); backMap != state.backMaps.rend(); ++backMap) {
+        std::vector<std::list<uint32_t>> prevV;
+        for (std::list<uint32_t>& ids : v) {
+            auto find = backMap->find(ids.front());
+            if (find == backMap->end()) continue;
+            std::vector<uint32_t> preds{find->second.first};
+            pool.sort(preds);
+            for (uint32_t pred : preds) {
+                prevV.emplace_back(ids).emplace_front(pred);
+            }
+        }
+        v = std::move(prevV);
+    }
+
+    std::vector<TuningSequence> sequences;
+    for (std::list<uint32_t>& ids : v) {
+        TuningSequence ts;
+        for (uint32_t id : ids) ts.addTuning(pool.get(id));
+        sequences.emplace_back(ts);
+    }
+    return sequences;
+}
+
+// Returns true if every ratio in the tuning has a (nonzero) numerator and
+//   denominator below 2^28, so that dividing it by one of its own ratios and
+//   multiplying its expansions back by that ratio cannot overflow
+bool isSmall(const Tuning& tuning) {
+    const unsigned long limit = 1ul << 28;
+    for (const NoteTuning& nt : tuning) {
+        if (nt.tuning.p == 0 || nt.tuning.q == 0 || nt.tuning.p >= limit || nt.tuning.q >= limit) return false;
+    }
+    return true;
+}
+
+// Returns the tunings of the given back-pointer map, mapped from their values.
+//   Tunings with the same value are inserted in the order of their Tunings.
+std::multimap<int, uint32_t> frontierOf(const std::unordered_map<uint32_t, std::pair<std::vector<uint32_t>, int>>& backMap, const TuningPool& pool) {
+    std::vector<uint32_t> keys;
+    for (auto& entry : backMap) keys.emplace_back(entry.first);
+    pool.sort(keys);
+    std::multimap<int, uint32_t> frontier;
+    for (uint32_t key : keys) {
+        frontier.insert(std::pair<int, uint32_t>{backMap.at(key).second, key});
+    }
+    return frontier;
+}
+
+// Records in backMap that the tuning next can be reached from prev with the
+//   given value, if that value is at least as good as the best one so far
+void reach(std::unordered_map<uint32_t, std::pair<std::vector<uint32_t>, int>>& backMap, uint32_t next, uint32_t prev, int value) {
+    auto find = backMap.find(next);
+    if (find == backMap.end()) {
+        backMap.emplace(next, std::pair<std::vector<uint32_t>, int>{std::vector<uint32_t>{prev}, value});
+    } else if (value > find->second.second) {
+        find->second = std::pair<std::vector<uint32_t>, int>{std::vector<uint32_t>{prev}, value};
+    } else if (value == find->second.second) {
+        find->second.first.emplace_back(prev);
+        COUNT(ties, 1);
+    }
+}
+
+// Returns a hash of the pitches of chord i of seq and the number of beats it
+//   lasts
+unsigned long chordHash(const ChordSequence& seq, unsigned int i) {
+    unsigned long h = 14695981039346656037ul;
+    for (const EPitch& pitch : seq[i]) {
+        h = (h ^ (12 * pitch.octave + static_cast<int>(pitch.pitch))) * 1099511628211ul;
+    }
+    return (h ^ seq.count(i)) * 1099511628211ul;
+}
+
+// Returns true if chords i and j of seq have the same pitches in the same
+//   order, and last the same number of beats
+bool sameChord(const ChordSequence& seq, unsigned int i, unsigned int j) {
+    PitchSpan a = seq[i];
+    PitchSpan b = seq[j];
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin()) && seq.count(i) == seq.count(j);
+}
+
+// Returns the value that chord i of seq adds for the beats after its first
+//   when it is tuned as the given tuning (see ChordSequence::counts), using
+//   the given interval table
+int heldValue(const ChordSequence& seq, unsigned int i, const Tuning& tuning, const Interval& intervals) {
+    unsigned int count = seq.count(i);
+    return count > 1 ? (count - 1) * Algo::evaluate(tuning, tuning, intervals) : 0;
+}
+
+// Returns the given tunings of the first two chords of seq (or of its only
+//   chord), with the held values of both chords (see heldValue) added to their
+//   values, using the given interval table
+std::multimap<int, Tuning> withHeld(const std::multimap<int, Tuning>& starts, const ChordSequence& seq, const Interval& intervals) {
+    if (!seq.counts) return starts;
+    std::multimap<int, Tuning> held;
+    for (auto& pair : starts) {
+        Tuning first = pair.second;
+        int value = pair.first;
+        if (seq.size() > 1) value += heldValue(seq, 1, first.split(seq[1]), intervals);
+        held.emplace(value + heldValue(seq, 0, first, intervals), pair.second);
+    }
+    return held;
+}
+
+// Returns the hashes of every window of the given number of consecutive
+//   chords in seq, by the index of its first chord. Each hash is computed from
+//   the previous one in constant time.
+std::vector<unsigned long> windowHashes(const ChordSequence& seq, unsigned int window) {
+    const unsigned long base = 1099511628211ul;
+    std::vector<unsigned long> hashes;
+    if (window == 0 || seq.size() < window) return hashes;
+
+    unsigned long top = 1;
+    unsigned long h = 0;
+    for (unsigned int i = 0; i < window; i++) {
+        if (i > 0) top *= base;
+        h = h * base + chordHash(seq, i);
+    }
+    hashes.emplace_back(h);
+    for (unsigned int i = window; i < seq.size(); i++) {
+        h = (h - chordHash(seq, i - window) * top) * base + chordHash(seq, i);
+        hashes.emplace_back(h);
+    }
+    return hashes;
+}
+
+// Returns true if frontier has as many tunings as earlier, and each of them is
+//   the tuning in the same position of earlier multiplied by a common scale,
+//   with its value increased by a common shift, setting scale and shift. The
+//   scale and every tuning must be small (see isSmall), so that scaling the
+//   tunings that follow from earlier cannot overflow.
+bool isScaled(const std::multimap<int, uint32_t>& frontier, const std::multimap<int, uint32_t>& earlier, const TuningPool& pool, Frac& scale, int& shift) {
+    if (frontier.empty() || frontier.size() != earlier.size()) return false;
+
+    const Tuning& first = pool.get(frontier.begin()->second);
+    const Tuning& earlierFirst = pool.get(earlier.begin()->second);
+    if (first.isEmpty() || earlierFirst.isEmpty() || !isSmall(first) || !isSmall(earlierFirst)) return false;
+    scale = (*first.begin()).tuning / (*earlierFirst.begin()).tuning;
+    shift = frontier.begin()->first - earlier.begin()->first;
+    if (!isSmall(Tuning{}.addNoteTuning(NoteTuning{EPitch{Pitch::C, 4}, scale}))) return false;
+
+    for (auto it = frontier.begin(), earlierIt = earlier.begin(); it != frontier.end(); ++it, ++earlierIt) {
+        const Tuning& tuning = pool.get(it->second);
+        if (it->first != earlierIt->first + shift || !isSmall(tuning) || !(tuning == pool.get(earlierIt->second) * scale)) return false;
+    }
+    return true;
+}
+
+// Fills backMap with the given back-pointer map of an earlier chord, with every
+//   tuning multiplied by scale and every value increased by shift. Returns
+//   false, leaving backMap incomplete, if one of the tunings is not small (see
+//   isSmall) once scaled.
+bool replay(const std::unordered_map<uint32_t, std::pair<std::vector<uint32_t>, int>>& earlier, const Frac& scale, int shift,
+    TuningPool& pool, std::unordered_map<uint32_t, std::pair<std::vector<uint32_t>, int>>& backMap) {
+
+    auto scaled = [&](uint32_t id, uint32_t& scaledId) {
+        Tuning tuning = pool.get(id) * scale;
+        if (!isSmall(tuning)) return false;
+        scaledId = pool.intern(tuning);
+        return true;
+    };
+    for (auto& entry : earlier) {
+        uint32_t next;
+        if (!scaled(entry.first, next)) return false;
+        std::pair<std::vector<uint32_t>, int>& back = backMap[next];
+        back.second = entry.second.second + shift;
+        for (uint32_t prev : entry.second.first) {
+            uint32_t scaledPrev;
+            if (!scaled(prev, scaledPrev)) return false;
+            back.first.emplace_back(scaledPrev);
+        }
+    }
+    return true;
+}
+
+// Keeps only the best trim tunings of the given frontier, if trim is nonzero
+void trimFrontier(std::multimap<int, uint32_t>& frontier, unsigned int trim) {
+    if ((trim == 0) || (frontier.size() <= trim)) return;
+    std::multimap<int, uint32_t> trimmed;
+    unsigned int j = 0;
+    for (auto it = frontier.rbegin(); j < trim; ++it) {
+        trimmed.insert(*it);
+        j++;
+    }
+    frontier = std::move(trimmed);
+}
+
+Algo::Solver::Solver(const Options& options, std::shared_ptr<SharedCache> shared):
+    options{options}, shared{}, pool{}, chordIds{}, chords{}, expansions{}, stats{} {
+
+    if (shared && sameSearch(shared->getOptions(), options)) {
+        this->shared = std::move(shared);
+    }
+}
+
+const Algo::Options& Algo::Solver::getOptions() const {
+    return options;
+}
+
+const Algo::Stats& Algo::Solver::getStats() const {
+    return stats;
+}
+
+void Algo::Solver::start() {
+    stats.solves++;
+    if (isFull()) clear();
+}
+
+uint32_t Algo::Solver::chordId(const std::vector<EPitch>& chord) {
+    auto find = chordIds.find(chord);
+    if (find != chordIds.end()) return find->second;
+    chords.emplace_back(chord);
+    chordIds.emplace(chord, chords.size() - 1);
+    return chords.size() - 1;
+}
+
+std::vector<std::pair<Tuning, int>> Algo::Solver::expand(const Tuning& fixed, uint32_t chord) {
+    const std::vector<EPitch>& var = chords[chord];
+    PitchSpan span{var.data(), var.data() + var.size()};
+    std::vector<std::pair<Tuning, int>> next;
+
+    if (!isSmall(fixed)) {
+        stats.searches++;
+        COUNT_TIME(searchNanoseconds);
+        for (auto& nextTuning : getValuesRec(fixed, span, options)) next.emplace_back(nextTuning);
+        return next;
+    }
+
+	// The expansions are normalized so that the lowest pitch of the tuning
+	//   they were expanded from has ratio 1
+    Frac offset = fixed.isEmpty() ? Frac{1, 1} : (*fixed.begin()).tuning;
+    uint32_t normal = pool.intern(fixed / offset);
+    uint64_t key = (static_cast<uint64_t>(normal) << 32) | chord;
+    auto find = expansions.find(key);
+    if (find != expansions.end()) {
+        stats.hits++;
+    } else {
+        std::vector<std::pair<Tuning, int>> normalTunings;
+        bool found = shared && shared->find(pool.get(normal), var, normalTunings);
+        if (found) {
+            stats.sharedHits++;
+        } else if (shared && shared->getDisk()) {
+            auto start = std::chrono::steady_clock::now();
+            found = shared->getDisk()->find(pool.get(normal), var, normalTunings);
+            stats.diskNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+            stats.diskLookups++;
+            if (found) stats.diskHits++;
+        }
+        if (found) {
+            find = expansions.emplace(key, std::move(normalTunings)).first;
+        } else {
+			// A tuning searched directly is returned as found, rather than
+			//   scaled back from its normalized form
+            stats.searches++;
+            COUNT_TIME(searchNanoseconds);
+            for (auto& nextTuning : getValuesRec(fixed, span, options)) {
+                normalTunings.emplace_back(nextTuning.first / offset, nextTuning.second);
+                next.emplace_back(nextTuning);
+            }
+            expansions.emplace(key, std::move(normalTunings));
+            return next;
+        }
+    }
+
+    COUNT(tunings, find->second.size());
+    for (auto& nextTuning : find->second) {
+        next.emplace_back(nextTuning.first * offset, nextTuning.second);
+    }
+    return next;
+}
+
+std::vector<TuningSequence> Algo::Solver::advance(SolveState& state, const ChordSequence& seq, int& value, Checkpoint* checkpoint) {
+	// The hashes of the windows of chords starting at every chord, and the
+	//   chords consumed so far at which every window started
+    std::vector<unsigned long> windows = windowHashes(seq, window);
+    std::unordered_map<unsigned long, std::vector<unsigned int>> starts;
+
+	// The trimmed frontier entering every chord consumed by this call, and
+	//   the chord after the one the last chord was replayed from, if any
+    std::vector<std::multimap<int, uint32_t>> entries(seq.size());
+    unsigned int following = seq.size();
+    const Interval& intervals = Interval::standard();
+
+    for (unsigned int i = state.backMaps.size(); i < seq.size(); i++) {
+        COUNT_TIME(stepNanoseconds);
+        trimFrontier(state.frontier, options.trim);
+        entries[i] = state.frontier;
+        COUNT(frontierTotal, state.frontier.size());
+        COUNT_PEAK(frontierPeak, state.frontier.size());
+
+		// If the chords from i repeat an earlier passage, and the frontier
+		//   entering i is the frontier entering the earlier chord up to scale,
+		//   the earlier chord's back-pointer map is replayed at that scale
+		//   instead of expanding the frontier. A passage being replayed is
+		//   followed first, then the last few earlier occurrences of the window
+		//   starting at i.
+        const unsigned int tries = 4;
+        std::vector<unsigned int> candidates;
+        if (following < i && sameChord(seq, following, i)) candidates.emplace_back(following);
+        if (i < windows.size()) {
+            std::vector<unsigned int>& earlier = starts[windows[i]];
+            for (auto it = earlier.rbegin(); it != earlier.rend() && it - earlier.rbegin() < tries; ++it) {
+                bool same = true;
+                for (unsigned int k = 0; k < window; k++) {
+                    if (!sameChord(seq, *it + k, i + k)) same = false;
+                }
+                if (same) candidates.emplace_back(*it);
+            }
+            earlier.emplace_back(i);
+        }
+
+        std::unordered_map<uint32_t, std::pair<std::vector<uint32_t>, int>> backMap;
+        Frac scale{1, 1};
+        int shift = 0;
+        unsigned int from = seq.size();
+        for (unsigned int candidate : candidates) {
+            if (isScaled(state.frontier, entries[candidate], pool, scale, shift)) {
+                from = candidate;
+                break;
+            }
+        }
+        bool replayed = from < seq.size() && replay(state.backMaps[from], scale, shift, pool, backMap);
+
+        if (replayed) {
+            if (from != following) stats.passages++;
+            stats.replayed++;
+            following = from + 1;
+        } else {
+            following = seq.size();
+            backMap.clear();
+            uint32_t chord = chordId(std::vector<EPitch>{seq[i].begin(), seq[i].end()});
+            std::unordered_map<uint32_t, int> held;
+            for (auto& prevTuning : state.frontier) {
+                Tuning tuning = pool.get(prevTuning.second);
+                for (auto& nextTuning : expand(tuning, chord)) {
+                    uint32_t next = pool.intern(nextTuning.first);
+                    int value = prevTuning.first + nextTuning.second;
+                    if (seq.count(i) > 1) {
+                        auto find = held.find(next);
+                        if (find == held.end()) find = held.emplace(next, heldValue(seq, i, nextTuning.first, intervals)).first;
+                        value += find->second;
+                    }
+                    reach(backMap, next, prevTuning.second, value);
+                }
+            }
+        }
+
+        state.frontier = frontierOf(backMap, pool);
+        state.backMaps.emplace_back(std::move(backMap));
+        stats.chords++;
+
+        if (checkpoint) checkpoint->tick(state, pool);
+    }
+
+    COUNT_TIME(backtrackNanoseconds);
+    return backtrack(state, pool, value);
+}
+
+std::vector<Tuning> Algo::Solver::getBestValues(const Tuning& fixed, const std::list<EPitch>& var) {
+    start();
+    COUNT_INTO(&stats.counters);
+	// The expansions are rebuilt into a map so that tunings with the same value
+	//   are returned in the same order as by a fresh search
+    std::vector<std::pair<Tuning, int>> next = expand(fixed, chordId(std::vector<EPitch>{var.begin(), var.end()}));
+    return bestOf(byValue(std::map<Tuning, int>{next.begin(), next.end()}));
+}
+
+std::vector<Tuning> Algo::Solver::getBestValues(const Tuning& fixed, const PitchSpan& var) {
+    start();
+    COUNT_INTO(&stats.counters);
+    std::vector<std::pair<Tuning, int>> next = expand(fixed, chordId(std::vector<EPitch>{var.begin(), var.end()}));
+    return bestOf(byValue(std::map<Tuning, int>{next.begin(), next.end()}));
+}
+
+std::vector<TuningSequence> Algo::Solver::getTunings(const ChordSequence& seq, int* val) {
+    return getTunings(seq, "", 0, val);
+}
+
+std::vector<TuningSequence> Algo::Solver::getTunings(const ChordSequence& seq, const std::string& file, unsigned int interval, int* val) {
+    start();
+    COUNT_INTO(&stats.counters);
+    int s = seq.size();
+
+    if (s == 0) return std::vector<TuningSequence>{};
+
+	// The first two chords are solved together. Their pitches are adjacent in
+	//   seq, so they can be passed as one range.
+    PitchSpan firstNotes = seq.range(0, std::min(s, 2));
+    std::vector<std::pair<Tuning, int>> firstTunings = expand(Tuning{}, chordId(std::vector<EPitch>{firstNotes.begin(), firstNotes.end()}));
+    std::multimap<int, Tuning> startTunings = withHeld(byValue(std::map<Tuning, int>{firstTunings.begin(), firstTunings.end()}), seq, Interval::standard());
+
+    if (s == 1) {
+        std::vector<TuningSequence> v;
+        for (Tuning& tuning : bestOf(startTunings)) {
+            v.emplace_back(TuningSequence{}.addTuning(tuning));
+        }
+        return v;
+    }
+
+    PitchSpan secondNotes = seq[1];
+
+    if (s == 2) {
+        std::vector<TuningSequence> v;
+        for (Tuning& tuning : bestOf(startTunings)) {
+            Tuning second = tuning.split(secondNotes);
+            v.emplace_back(TuningSequence{}.addTuning(tuning).addTuning(second));
+        }
+        return v;
+    }
+
+    std::unique_ptr<Checkpoint> checkpoint;
+    SolveState state{0, -1, {}, {}, {}};
+    bool resumed = false;
+    if (!file.empty()) {
+        checkpoint = std::make_unique<Checkpoint>(file, fingerprint(seq, options.trim, options), interval);
+        resumed = checkpoint->load(state, pool);
+    }
+
+    ChordSequence rest = seq.from(2);
+
+    unsigned int i = 0;
+    for (auto& pair : startTunings) {
+        if (i++ < state.start) continue;
+
+        Tuning& first = pair.second;
+        Tuning second = first.split(secondNotes);
+        int value = -1;
+        if (!resumed) {
+            state.frontier.clear();
+            state.frontier.insert(std::pair<int, uint32_t>{pair.first, pool.intern(second)});
+            state.backMaps.clear();
+        }
+        resumed = false;
+
+        std::vector<TuningSequence> bestTunings = advance(state, rest, value, checkpoint.get());
+
+        if (value > state.bestValue) {
+            state.bestValue = value;
+            state.best.clear();
+            for (TuningSequence& bestTuning : bestTunings) {
+                state.best.emplace_back(first + bestTuning);
+            }
+        } else if (value == state.bestValue) {
+            for (TuningSequence& bestTuning : bestTunings) {
+                state.best.emplace_back(first + bestTuning);
+            }
+        }
+        state.start = i;
+    }
+
+    if (checkpoint) checkpoint->finish();
+    if (val) *val = state.bestValue;
+    return state.best;
+}
+
+std::vector<TuningSequence> Algo::Solver::getTuningsAfter(const Tuning& prev, const ChordSequence& seq, int* val) {
+    start();
+    COUNT_INTO(&stats.counters);
+    if (seq.size() == 0) return std::vector<TuningSequence>{};
+
+    SolveState state{0, -1, {}, {}, {}};
+    state.frontier.insert(std::pair<int, uint32_t>{0, pool.intern(prev)});
+
+    int value = -1;
+    std::vector<TuningSequence> sequences;
+    for (const TuningSequence& ts : advance(state, seq, value, nullptr)) {
+		// Every sequence starts with prev
+        TuningSequence rest;
+        auto it = ts.begin();
+        for (++it; it != ts.end(); ++it) rest.addTuning(*it);
+        sequences.emplace_back(rest);
+    }
+    if (val) *val = value;
+    return sequences;
+}
+
+std::vector<std::vector<TuningSequence>> Algo::Solver::getTunings(const ChordSequence& seq, const std::vector<Interval>& profiles, std::vector<int>* values) {
+    checkProfiles(profiles);
+    start();
+    COUNT_INTO(&stats.counters);
+    unsigned int k = profiles.size();
+    int s = seq.size();
+    std::vector<std::vector<TuningSequence>> v(k);
+    if (values) values->assign(k, -1);
+
+    if (s == 0) return v;
+
+    std::map<Tuning, std::vector<int>> startTunings = getValuesMulti(Tuning{}, seq.range(0, std::min(s, 2)), profiles);
+    if (seq.counts) {
+        for (auto& pair : startTunings) {
+            Tuning first = pair.first;
+            Tuning second = s > 1 ? first.split(seq[1]) : Tuning{};
+            for (unsigned int i = 0; i < k; i++) {
+                if (pair.second[i] < 0) continue;
+                pair.second[i] += heldValue(seq, 0, first, profiles[i]) + (s > 1 ? heldValue(seq, 1, second, profiles[i]) : 0);
+            }
+        }
+    }
+
+    if (s == 1) {
+        std::vector<std::vector<Tuning>> bestTunings = bestOfEach(startTunings, k);
+        for (unsigned int i = 0; i < k; i++) {
+            for (Tuning& tuning : bestTunings[i]) {
+                v[i].emplace_back(TuningSequence{}.addTuning(tuning));
+            }
+        }
+        return v;
+    }
+
+    PitchSpan secondNotes = seq[1];
+
+    if (s == 2) {
+        std::vector<std::vector<Tuning>> bestTunings = bestOfEach(startTunings, k);
+        for (unsigned int i = 0; i < k; i++) {
+            for (Tuning& tuning : bestTunings[i]) {
+                Tuning second = tuning.split(secondNotes);
+                v[i].emplace_back(TuningSequence{}.addTuning(tuning).addTuning(second));
+            }
+        }
+        return v;
+    }
+
+    ChordSequence rest = seq.from(2);
+    std::vector<SolveState> states(k, SolveState{0, -1, {}, {}, {}});
+
+	// The expansions of every normalized tuning through every chord (see
+	//   expand), keyed in the same way, along with the profiles they were
+	//   searched for. The values of a profile do not depend on which other
+	//   profiles were searched with it, so an expansion is reused for the
+	//   profiles it has, and only the profiles it lacks are searched.
+    std::unordered_map<uint64_t, std::pair<unsigned long, std::map<Tuning, std::vector<int>>>> found;
+
+    for (auto& pair : startTunings) {
+        Tuning first = pair.first;
+        Tuning second = first.split(secondNotes);
+        unsigned long started = 0;
+        for (unsigned int i = 0; i < k; i++) {
+            if (pair.second[i] < 0) continue;
+            started |= 1ul << i;
+            states[i].frontier.clear();
+            states[i].frontier.insert(std::pair<int, uint32_t>{pair.second[i], pool.intern(second)});
+            states[i].backMaps.clear();
+        }
+
+		// Every profile advances through the same chord together, so that a
+		//   tuning in the frontier of several profiles is only expanded once
+        for (unsigned int c = 0; c < rest.size(); c++) {
+            PitchSpan chord = rest[c];
+            std::unordered_map<uint32_t, unsigned long> requested;
+            for (unsigned int i = 0; i < k; i++) {
+                if (!(started & (1ul << i))) continue;
+                trimFrontier(states[i].frontier, options.trim);
+                for (auto& prevTuning : states[i].frontier) {
+                    requested[prevTuning.second] |= 1ul << i;
+                }
+            }
+
+            uint32_t id = chordId(std::vector<EPitch>{chord.begin(), chord.end()});
+            std::unordered_map<uint32_t, std::vector<std::pair<uint32_t, std::vector<int>>>> multiExpansions;
+            for (auto& entry : requested) {
+                std::vector<std::pair<uint32_t, std::vector<int>>>& nextTunings = multiExpansions[entry.first];
+                Tuning tuning = pool.get(entry.first);
+                std::map<Tuning, std::vector<int>> direct;
+                const std::map<Tuning, std::vector<int>>* next = &direct;
+                Frac offset{1, 1};
+                if (!isSmall(tuning)) {
+                    stats.searches++;
+                    direct = getValuesMulti(tuning, chord, profiles, entry.second);
+                } else {
+                    offset = (*tuning.begin()).tuning;
+                    uint32_t normal = pool.intern(tuning / offset);
+                    auto& cached = found[(static_cast<uint64_t>(normal) << 32) | id];
+                    unsigned long missing = entry.second & ~cached.first;
+                    if (missing) {
+                        stats.searches++;
+                        for (auto& nextTuning : getValuesMulti(pool.get(normal), chord, profiles, missing)) {
+                            std::vector<int>& values = cached.second.emplace(nextTuning.first, std::vector<int>(k, -1)).first->second;
+                            for (unsigned int i = 0; i < k; i++) {
+                                if (missing & (1ul << i)) values[i] = nextTuning.second[i];
+                            }
+                        }
+                        cached.first |= missing;
+                    } else {
+                        stats.hits++;
+                    }
+                    next = &cached.second;
+                }
+
+                for (auto& nextTuning : *next) {
+                    Tuning scaled = nextTuning.first * offset;
+                    std::vector<int> nextValues(k, -1);
+                    for (unsigned int i = 0; i < k; i++) {
+                        if (!(entry.second & (1ul << i)) || nextTuning.second[i] < 0) continue;
+                        nextValues[i] = nextTuning.second[i] + (rest.count(c) > 1 ? heldValue(rest, c, scaled, profiles[i]) : 0);
+                    }
+                    nextTunings.emplace_back(pool.intern(scaled), nextValues);
+                }
+            }
+
+            for (unsigned int i = 0; i < k; i++) {
+                if (!(started & (1ul << i))) continue;
+                std::unordered_map<uint32_t, std::pair<std::vector<uint32_t>, int>> backMap;
+                for (auto& prevTuning : states[i].frontier) {
+                    for (auto& nextTuning : multiExpansions[prevTuning.second]) {
+                        if (nextTuning.second[i] < 0) continue;
+                        reach(backMap, nextTuning.first, prevTuning.second, prevTuning.first + nextTuning.second[i]);
+                    }
+                }
+
+                states[i].frontier = frontierOf(backMap, pool);
+                states[i].backMaps.emplace_back(std::move(backMap));
+            }
+            stats.chords++;
+        }
+
+        for (unsigned int i = 0; i < k; i++) {
+            if (!(started & (1ul << i))) continue;
+            SolveState& state = states[i];
+            int value = -1;
+            std::vector<TuningSequence> bestTunings = backtrack(state, pool, value);
+            if (value > state.bestValue) {
+                state.bestValue = value;
+                state.best.clear();
+            }
+            if (value == state.bestValue) {
+                for (TuningSequence& bestTuning : bestTunings) {
+                    state.best.emplace_back(first + bestTuning);
+                }
+            }
+        }
+    }
+
+    for (unsigned int i = 0; i < k; i++) {
+        v[i] = std::move(states[i].best);
+        if (values) (*values)[i] = states[i].bestValue;
+    }
+    return v;
+}
+
+void Algo::Solver::publish() {
+    if (!shared) return;
+    for (auto& entry : expansions) {
+        shared->insert(pool.get(entry.first >> 32), chords[entry.first & 0xffffffffu], entry.second);
+    }
+}
+
+void Algo::Solver::clear() {
+    pool.clear();
+    chordIds.clear();
+    chords.clear();
+    expansions.clear();
+}
+
+bool Algo::Solver::isFull() const {
+    return pool.size() > limit;
+}
@@ -0,0 +1,214 @@
+#ifndef _SOLVER_H_
+#define _SOLVER_H_
+
+#include <cstdint>
+#include <vector>
+#include <list>
+#include <map>
+#include <unordered_map>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <utility>
+#include <functional>
+
+#include "pitch.h"
+#include "interval.h"
+#include "tunings.h"
+#include "hash.h"
+#include "pool.h"
+#include "algo.h"
+#include "counters.h"
+
+struct SolveState;
+class Checkpoint;
+
+namespace Algo {
+
+class DiskCache;
+
+struct Stats {
+	// Struct that packages the counters of a Solver: the number of calls made
+	//   to it, the number of chords consumed by its sequence solves, and how
+	//   many expansions of a tuning through a chord were searched, found in its
+	//   own cache, or found in its shared cache. Also counts the repeated
+	//   passages found by the sequence solves, and how many of the chords
+	//   consumed were replayed from an earlier chord (see Solver).
+    unsigned long solves = 0;
+    unsigned long chords = 0;
+    unsigned long searches = 0;
+    unsigned long hits = 0;
+    unsigned long sharedHits = 0;
+    unsigned long passages = 0;
+    unsigned long replayed = 0;
+
+	// The lookups made in the DiskCache of the shared cache (after both
+	//   caches in memory missed), how many of them hit, and the total time
+	//   they took in nanoseconds
+    unsigned long diskLookups = 0;
+    unsigned long diskHits = 0;
+    unsigned long diskNanoseconds = 0;
+
+	// The instrumentation counters of the solves, which are only gathered
+	//   when they are compiled in (see Counters)
+    Counters counters;
+};
+
+class SharedCache {
+	// Class that stores expansions of tunings through chords (see Solver) so
+	//   that they can be read by several Solvers at once, possibly on
+	//   different threads. Solvers only read from the cache while solving; the
+	//   expansions they found are added to it by Solver::publish. Every method
+	//   is thread-safe.
+	// A SharedCache can be backed by a DiskCache, which Solvers look
+	//   expansions up in when the SharedCache misses, so that they reuse the
+	//   expansions found by earlier processes. The expansions found are added
+	//   to the cache file with DiskCache::merge.
+    private:
+        Options options;
+        std::shared_ptr<const DiskCache> disk;
+        mutable std::shared_mutex mutex;
+        std::unordered_map<Tuning, std::map<std::vector<EPitch>, std::vector<std::pair<Tuning, int>>>, Hash> entries;
+
+    public:
+		// Create an empty cache for Solvers with the given options. Only the
+		//   options compared by sameSearch matter, since they decide the
+		//   expansions found. If disk is non-null, the cache is backed by it,
+		//   unless it was written with options that search differently.
+        explicit SharedCache(const Options& options = Options{}, std::shared_ptr<const DiskCache> disk = nullptr);
+
+		// Returns the options the cache was created with
+        const Options& getOptions() const;
+
+		// Returns the DiskCache backing the cache, or null if it has none
+        const DiskCache* getDisk() const;
+
+		// Returns true and sets expansions to the expansions of the given
+		//   normalized tuning through the given chord if they are in the cache,
+		//   and returns false otherwise
+        bool find(const Tuning& normal, const std::vector<EPitch>& chord, std::vector<std::pair<Tuning, int>>& expansions) const;
+
+		// Add the expansions of the given normalized tuning through the given
+		//   chord, unless the cache already has them
+        void insert(const Tuning& normal, const std::vector<EPitch>& chord, const std::vector<std::pair<Tuning, int>>& expansions);
+
+		// Returns the number of expansions in the cache (not counting its
+		//   DiskCache)
+        unsigned int size() const;
+
+		// Calls f with the normalized tuning, the chord and the expansions of
+		//   every entry of the cache (not counting its DiskCache). f must not
+		//   use the cache.
+        void forEach(const std::function<void(const Tuning&, const std::vector<EPitch>&, const std::vector<std::pair<Tuning, int>>&)>& f) const;
+
+		// Remove every expansion from the cache
+        void clear();
+};
+
+class Solver {
+	// Class that solves chords and sequences of chords like the free functions
+	//   of Algo, but owns everything a solve uses: its options, a pool of the
+	//   tunings it reaches, a cache of the expansions of tunings through
+	//   chords, and counters. The free functions solve with a new Solver
+	//   every time; keeping a Solver between solves keeps its cache warm.
+	// Tunings that only differ by a common factor have the same expansions
+	//   through a chord (scaled by that factor), so the cache is keyed by the
+	//   chord and the tuning divided by the ratio of its lowest pitch. Tunings
+	//   with large ratios are expanded directly, since normalizing them could
+	//   overflow. The pool and the cache are cleared before a solve once the
+	//   pool holds more than limit tunings.
+	// Sequences often repeat passages. Every window of consecutive chords is
+	//   hashed as the sequence is consumed, so a window that starts a repeat
+	//   is matched to the last earlier one with the same chords. When the
+	//   frontier entering the repeat is the frontier entering the earlier
+	//   passage multiplied by a common ratio (with values offset by a common
+	//   amount), the DP steps that follow are the same up to that ratio, so
+	//   the back-pointer maps of the earlier passage are replayed, scaled,
+	//   for as long as the chords keep repeating and the frontiers keep
+	//   matching.
+	// A Solver must only be used by one thread at a time, but any number of
+	//   Solvers can run concurrently. They can share a SharedCache, which they
+	//   look expansions up in when their own cache misses.
+    private:
+        Options options;
+        std::shared_ptr<SharedCache> shared;
+        TuningPool pool;
+
+		// The chords expanded through, identified by their index, and the
+		//   expansions of every normalized tuning through every chord, keyed
+		//   by the ID of the tuning in pool and the index of the chord
+        std::map<std::vector<EPitch>, uint32_t> chordIds;
+        std::vector<std::vector<EPitch>> chords;
+        std::unordered_map<uint64_t, std::vector<std::pair<Tuning, int>>> expansions;
+
+        Stats stats;
+
+		// Prepare for a new call: count it, and clear the pool and the cache if
+		//   the pool holds more than limit tunings
+        void start();
+
+		// Returns the index of the given chord in chords, adding it if needed
+        uint32_t chordId(const std::vector<EPitch>& chord);
+
+		// Returns every tuning of the chord with the given index against the
+		//   given fixed tuning, with its value, in the order of the tunings
+		//   (see getValuesRec)
+        std::vector<std::pair<Tuning, int>> expand(const Tuning& fixed, uint32_t chord);
+
+		// Advances the frontier of the given state through every chord of seq
+		//   that it has not consumed yet (one back-pointer map is kept per
+		//   consumed chord), trimming the frontier to its best tunings before
+		//   each chord, and replaying repeated passages. Then returns every
+		//   optimal TuningSequence through the consumed chords, setting value
+		//   to their value. If checkpoint is non-null, it is notified after
+		//   every chord.
+        std::vector<TuningSequence> advance(SolveState& state, const ChordSequence& seq, int& value, Checkpoint* checkpoint);
+
+    public:
+		// Largest number of tunings kept in the pool between solves
+        static const unsigned int limit = 1 << 18;
+
+		// Number of chords in the windows hashed to find repeated passages
+        static const unsigned int window = 4;
+
+		// Create a Solver with the given options. If shared is non-null, its
+		//   expansions are used when the Solver's own cache misses; it must have
+		//   been created with options that search the same way (see
+		//   sameSearch), otherwise it is ignored.
+        explicit Solver(const Options& options = Options{}, std::shared_ptr<SharedCache> shared = nullptr);
+
+		// Returns the options of the Solver
+        const Options& getOptions() const;
+
+		// Returns the counters of the Solver since it was created (clearing the
+		//   Solver does not reset them)
+        const Stats& getStats() const;
+
+		// Same as the free functions of the same name, with the options of the
+		//   Solver
+        std::vector<Tuning> getBestValues(const Tuning& fixed, const std::list<EPitch>& var);
+        std::vector<Tuning> getBestValues(const Tuning& fixed, const PitchSpan& var);
+        std::vector<TuningSequence> getTunings(const ChordSequence& seq, int* value = nullptr);
+        std::vector<TuningSequence> getTunings(const ChordSequence& seq, const std::string& file, unsigned int interval, int* value = nullptr);
+        std::vector<TuningSequence> getTuningsAfter(const Tuning& prev, const ChordSequence& seq, int* value = nullptr);
+
+		// Same as the free function of the same name. Every profile is solved
+		//   exactly, with the trim of the options of the Solver.
+        std::vector<std::vector<TuningSequence>> getTunings(const ChordSequence& seq, const std::vector<Interval>& profiles, std::vector<int>* values = nullptr);
+
+		// Add every expansion in the Solver's own cache to its shared cache, if
+		//   it has one
+        void publish();
+
+		// Remove every tuning, chord and expansion from the Solver's own cache
+        void clear();
+
+		// Returns true if the next call will clear the Solver's own cache
+		//   first (see limit), so that a caller holding locks can swap in a
+		//   fresh Solver and free the full one after releasing them
+        bool isFull() const;
+};
+
+}
+
+#endif
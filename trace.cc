@@ -0,0 +1,139 @@
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "trace.h"
+
+std::atomic<bool> Trace::active{false};
+
+struct TraceEvent {
+	// An event in a ring buffer. Its fields are atomic since a dump may read
+	//   it while its thread overwrites it.
+    std::atomic<const char*> name;
+    std::atomic<uint64_t> start;
+    std::atomic<uint64_t> end;
+};
+
+struct TraceBuffer {
+	// The ring buffer of a thread: its ID and name in the trace, and the
+	//   number of events it has recorded, of which the last capacity are
+	//   kept. Only its thread writes to it.
+    unsigned int id;
+    std::string name;
+    std::atomic<uint64_t> written{0};
+    TraceEvent events[Trace::capacity];
+};
+
+// The buffers of every thread that has recorded an event, which are never
+//   freed, so that the events of threads that exited can be dumped. The mutex
+//   guards the list and the names of the buffers, and is only taken once per
+//   thread when recording.
+static std::mutex buffersMutex;
+static std::vector<TraceBuffer*> buffers;
+static thread_local TraceBuffer* threadBuffer = nullptr;
+
+static TraceBuffer* getBuffer() {
+    if (!threadBuffer) {
+        std::unique_lock<std::mutex> lock(buffersMutex);
+        threadBuffer = new TraceBuffer;
+        threadBuffer->id = buffers.size() + 1;
+        buffers.emplace_back(threadBuffer);
+    }
+    return threadBuffer;
+}
+
+// Writes the given string as a JSON string
+static void putString(std::ostream& out, const std::string& s) {
+    out << '"';
+    for (char c : s) {
+        if (c == '"' || c == '\\') out << '\\';
+        if (static_cast<unsigned char>(c) >= 0x20) out << c;
+    }
+    out << '"';
+}
+
+///////////////////////////////////////////////////////////////
+
+void Trace::start() {
+    now();
+    active.store(true);
+}
+
+void Trace::stop() {
+    active.store(false);
+}
+
+void Trace::nameThread(const std::string& name) {
+    TraceBuffer* buffer = getBuffer();
+    std::unique_lock<std::mutex> lock(buffersMutex);
+    buffer->name = name;
+}
+
+uint64_t Trace::now() {
+    static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+void Trace::record(const char* name, uint64_t start, uint64_t end) {
+    TraceBuffer* buffer = getBuffer();
+    uint64_t n = buffer->written.load(std::memory_order_relaxed);
+    TraceEvent& event = buffer->events[n % capacity];
+    event.name.store(name, std::memory_order_relaxed);
+    event.start.store(start, std::memory_order_relaxed);
+    event.end.store(end, std::memory_order_relaxed);
+    buffer->written.store(n + 1, std::memory_order_release);
+}
+
+bool Trace::dump(const std::string& file) {
+    std::ofstream out{file};
+    if (!out) return false;
+    out.setf(std::ios::fixed);
+    out.precision(3);
+    out << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [";
+    bool first = true;
+    std::unique_lock<std::mutex> lock(buffersMutex);
+    for (TraceBuffer* buffer : buffers) {
+        out << (first ? "\n" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << buffer->id
+            << ", \"args\": {\"name\": ";
+        putString(out, buffer->name.empty() ? "thread " + std::to_string(buffer->id) : buffer->name);
+        out << "}}";
+        first = false;
+
+		// The events are copied, then the ones the thread may have overwritten
+		//   while they were copied (those at least capacity events older than
+		//   the events it has recorded since) are dropped
+        uint64_t written = buffer->written.load(std::memory_order_acquire);
+        uint64_t from = written > capacity ? written - capacity : 0;
+        struct Copy {
+            const char* name;
+            uint64_t start;
+            uint64_t end;
+        };
+        std::vector<Copy> events;
+        events.reserve(written - from);
+        for (uint64_t n = from; n < written; n++) {
+            const TraceEvent& event = buffer->events[n % capacity];
+            events.emplace_back(Copy{event.name.load(std::memory_order_relaxed), event.start.load(std::memory_order_relaxed),
+                                     event.end.load(std::memory_order_relaxed)});
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t after = buffer->written.load(std::memory_order_relaxed);
+        uint64_t valid = after >= capacity ? after - capacity + 1 : 0;
+
+        for (uint64_t n = std::max(from, valid); n < written; n++) {
+            const Copy& event = events[n - from];
+            out << ",\n{\"name\": ";
+            putString(out, event.name);
+            out << ", \"ph\": \"X\", \"pid\": 1, \"tid\": " << buffer->id << ", \"ts\": " << event.start / 1000.0
+                << ", \"dur\": " << (event.end - event.start) / 1000.0 << "}";
+        }
+    }
+    out << "\n]}\n";
+    out.flush();
+    return static_cast<bool>(out);
+}
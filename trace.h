@@ -0,0 +1,73 @@
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace Trace {
+	// Contains a timeline of scoped events on every thread, e.g. of the
+	//   Controller, its refresh worker and the Receiver's audio thread, that
+	//   can be dumped as a Chrome trace (for chrome://tracing or Perfetto)
+	//   to see how long every step took and how long it waited for locks.
+	// Every thread records its events in its own ring buffer, which keeps
+	//   its last capacity events, so recording an event takes no lock. The
+	//   buffers are kept after their threads exit, so that their events can
+	//   still be dumped. Nothing is recorded until recording is started, and
+	//   a scope costs a single atomic load while it is not.
+
+	// Number of events kept for every thread
+    const unsigned int capacity = 1 << 14;
+
+	// Whether events are being recorded. Use start and stop to change it.
+    extern std::atomic<bool> active;
+
+	// Start recording events
+    void start();
+
+	// Stop recording events. The events recorded are kept.
+    void stop();
+
+	// Name the calling thread in the trace
+    void nameThread(const std::string& name);
+
+	// Writes the events of every thread to a Chrome trace file (JSON) with
+	//   the given name. Can be called while events are being recorded.
+	//   Returns true if the file was written.
+    bool dump(const std::string& file);
+
+	// Returns the time in nanoseconds since the first event of the process
+    uint64_t now();
+
+	// Records an event with the given name that started and ended at the
+	//   given times (see now) on the calling thread
+    void record(const char* name, uint64_t start, uint64_t end);
+
+    class Scope {
+		// Class that records an event from its construction to its destruction
+		//   (or to end, if that is called first), if events are being recorded
+		//   when it is constructed. The name must outlive the trace, like a
+		//   string literal.
+        private:
+            const char* name;
+            uint64_t start;
+
+        public:
+            explicit Scope(const char* name): name{active.load(std::memory_order_relaxed) ? name : nullptr}, start{this->name ? now() : 0} {}
+
+            ~Scope() {
+                end();
+            }
+
+            Scope(const Scope&) = delete;
+            Scope& operator=(const Scope&) = delete;
+
+			// Ends the event early, e.g. once a lock has been acquired
+            void end() {
+                if (name) record(name, start, now());
+                name = nullptr;
+            }
+    };
+}
+
+#endif
@@ -0,0 +1,190 @@
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <map>
+#include <utility>
+
+#include "frac.h"
+#include "pitch.h"
+#include "tunings.h"
+#include "mapped.h"
+#include "tuningfile.h"
+
+static_assert(sizeof(EPitch) == 8 && sizeof(unsigned int) == 4, "pitches and offsets are stored as they are in memory");
+
+const char MAGIC[4] = {'D', 'T', 'S', 'Q'};
+const uint32_t ORDER_MARK = 0x01020304;
+
+struct TuningFileHeader {
+	// The header at the start of a file: the sizes of the sections, and where
+	//   they start. Every section starts on a multiple of 8 bytes.
+    char magic[4];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t chords;
+    uint32_t entries;
+    uint32_t ratios;
+    double relFreq;
+    uint64_t offsetsAt;
+    uint64_t pitchesAt;
+    uint64_t freqsAt;
+    uint64_t ratioIdsAt;
+    uint64_t ratiosAt;
+    uint64_t size;
+};
+
+// Returns the given number of bytes rounded up to a multiple of 8
+static uint64_t aligned(uint64_t bytes) {
+    return (bytes + 7) & ~static_cast<uint64_t>(7);
+}
+
+static bool putSection(std::FILE* out, const void* data, uint64_t bytes) {
+    static const char padding[8] = {};
+    return std::fwrite(data, 1, bytes, out) == bytes && std::fwrite(padding, 1, aligned(bytes) - bytes, out) == aligned(bytes) - bytes;
+}
+
+bool saveTunings(const std::string& name, const TuningSequence& sequence) {
+    std::vector<unsigned int> offsets{0};
+    std::vector<EPitch> pitches;
+    std::vector<double> freqs;
+    std::vector<uint32_t> ratioIds;
+    std::vector<uint64_t> ratios;
+    std::map<std::pair<unsigned long, unsigned long>, uint32_t> ids;
+    double relFreq = sequence.getRelFreq();
+    for (const Tuning& tuning : sequence) {
+        for (const NoteTuning& nt : tuning) {
+            auto id = ids.emplace(std::make_pair(nt.tuning.p, nt.tuning.q), ids.size());
+            if (id.second) {
+                ratios.emplace_back(nt.tuning.p);
+                ratios.emplace_back(nt.tuning.q);
+            }
+            pitches.emplace_back(nt.pitch);
+            freqs.emplace_back(nt.getEPitchFreq(relFreq).freq);
+            ratioIds.emplace_back(id.first->second);
+        }
+        offsets.emplace_back(pitches.size());
+    }
+
+    TuningFileHeader header;
+    std::memcpy(header.magic, MAGIC, 4);
+    header.version = TuningFile::version;
+    header.byteOrder = ORDER_MARK;
+    header.chords = offsets.size() - 1;
+    header.entries = pitches.size();
+    header.ratios = ids.size();
+    header.relFreq = relFreq;
+    header.offsetsAt = aligned(sizeof(header));
+    header.pitchesAt = header.offsetsAt + aligned(offsets.size() * sizeof(unsigned int));
+    header.freqsAt = header.pitchesAt + aligned(pitches.size() * sizeof(EPitch));
+    header.ratioIdsAt = header.freqsAt + aligned(freqs.size() * sizeof(double));
+    header.ratiosAt = header.ratioIdsAt + aligned(ratioIds.size() * sizeof(uint32_t));
+    header.size = header.ratiosAt + aligned(ratios.size() * sizeof(uint64_t));
+
+    std::FILE* out = std::fopen(name.c_str(), "wb");
+    if (!out) return false;
+    bool written = putSection(out, &header, sizeof(header))
+                && putSection(out, offsets.data(), offsets.size() * sizeof(unsigned int))
+                && putSection(out, pitches.data(), pitches.size() * sizeof(EPitch))
+                && putSection(out, freqs.data(), freqs.size() * sizeof(double))
+                && putSection(out, ratioIds.data(), ratioIds.size() * sizeof(uint32_t))
+                && putSection(out, ratios.data(), ratios.size() * sizeof(uint64_t));
+    return std::fclose(out) == 0 && written;
+}
+
+TuningFile::TuningFile(): file{}, chords{0}, entries{0}, ratioCount{0}, relFreq{0}, offsets{nullptr}, pitches{nullptr}, freqs{nullptr}, ratioIds{nullptr}, ratios{nullptr} {}
+
+bool TuningFile::open(const std::string& name) {
+    close();
+    if (!file.open(name)) return false;
+    TuningFileHeader header;
+    if (file.size() < sizeof(header)) {
+        close();
+        return false;
+    }
+    std::memcpy(&header, file.data(), sizeof(header));
+
+	// The sections must be where the header says they are and fill the file
+    uint64_t expected = aligned(sizeof(header));
+    bool valid = std::memcmp(header.magic, MAGIC, 4) == 0 && header.version == version && header.byteOrder == ORDER_MARK
+              && header.size == file.size() && header.offsetsAt == expected
+              && header.pitchesAt == (expected += aligned((header.chords + 1ull) * sizeof(unsigned int)))
+              && header.freqsAt == (expected += aligned(header.entries * sizeof(EPitch)))
+              && header.ratioIdsAt == (expected += aligned(header.entries * sizeof(double)))
+              && header.ratiosAt == (expected += aligned(header.entries * sizeof(uint32_t)))
+              && header.size == expected + aligned(2ull * header.ratios * sizeof(uint64_t));
+    if (!valid) {
+        close();
+        return false;
+    }
+    const unsigned char* data = file.data();
+    offsets = reinterpret_cast<const unsigned int*>(data + header.offsetsAt);
+    pitches = reinterpret_cast<const EPitch*>(data + header.pitchesAt);
+    freqs = reinterpret_cast<const double*>(data + header.freqsAt);
+    ratioIds = reinterpret_cast<const uint32_t*>(data + header.ratioIdsAt);
+    ratios = reinterpret_cast<const uint64_t*>(data + header.ratiosAt);
+    chords = header.chords;
+    entries = header.entries;
+    ratioCount = header.ratios;
+    relFreq = header.relFreq;
+    return true;
+}
+
+void TuningFile::close() {
+    file.close();
+    chords = entries = ratioCount = 0;
+    relFreq = 0;
+    offsets = nullptr;
+    pitches = nullptr;
+    freqs = nullptr;
+    ratioIds = nullptr;
+    ratios = nullptr;
+}
+
+bool TuningFile::verify() const {
+    if (!offsets || offsets[0] != 0 || offsets[chords] != entries) return false;
+    for (uint32_t i = 0; i < chords; i++) {
+        if (offsets[i] > offsets[i + 1]) return false;
+    }
+    for (uint32_t k = 0; k < entries; k++) {
+        if (ratioIds[k] >= ratioCount) return false;
+    }
+    for (uint32_t r = 0; r < 2 * ratioCount; r++) {
+        if (ratios[r] == 0) return false;
+    }
+    return true;
+}
+
+unsigned int TuningFile::size() const {
+    return chords;
+}
+
+ChordSequence TuningFile::getChords() const {
+    return ChordSequence{pitches, offsets, chords};
+}
+
+FreqSpan TuningFile::operator[](unsigned int i) const {
+    return FreqSpan{pitches + offsets[i], freqs + offsets[i], offsets[i + 1] - offsets[i]};
+}
+
+Frac TuningFile::getRatio(unsigned int i, unsigned int k) const {
+    uint32_t id = ratioIds[offsets[i] + k];
+    return Frac{ratios[2 * id], ratios[2 * id + 1]};
+}
+
+double TuningFile::getRelFreq() const {
+    return relFreq;
+}
+
+TuningSequence TuningFile::getTunings() const {
+    TuningSequence sequence;
+    for (unsigned int i = 0; i < chords; i++) {
+        Tuning tuning;
+        for (unsigned int k = 0; k < offsets[i + 1] - offsets[i]; k++) {
+            tuning.addNoteTuning(NoteTuning{pitches[offsets[i] + k], getRatio(i, k)});
+        }
+        sequence.addTuning(tuning);
+    }
+    return sequence;
+}
@@ -0,0 +1,84 @@
+#ifndef _TUNINGFILE_H_
+#define _TUNINGFILE_H_
+
+#include <cstdint>
+#include <string>
+
+#include "frac.h"
+#include "pitch.h"
+#include "mapped.h"
+
+class TuningSequence;
+
+// Writes the given TuningSequence to a binary file with the given name, which
+//   can be opened with a TuningFile. Returns true if the file was written.
+bool saveTunings(const std::string& file, const TuningSequence&);
+
+class TuningFile {
+	// Class that reads a TuningSequence saved by saveTunings. The file is
+	//   memory-mapped and its sections are laid out so that they can be used
+	//   where they are: the chord offsets, the pitches and the frequencies of
+	//   the tunings (relative to the same frequency as TuningSequence::getFreqs)
+	//   are arrays of native values, so opening a file only checks its header,
+	//   and the chords and their frequencies are returned as views into it.
+	//   The ratios of the tunings are stored once each in a table, and every
+	//   pitch refers to its ratio by its index in the table, since consecutive
+	//   chords mostly share their ratios.
+	// The format is versioned: a file written by another version of the
+	//   format, or on a machine with another byte order, is not opened.
+    private:
+        MappedFile file;
+        uint32_t chords;
+        uint32_t entries;
+        uint32_t ratioCount;
+        double relFreq;
+        const unsigned int* offsets;
+        const EPitch* pitches;
+        const double* freqs;
+        const uint32_t* ratioIds;
+        const uint64_t* ratios;
+
+    public:
+		// Version of the format written by saveTunings
+        static const uint32_t version = 1;
+
+		// Create a TuningFile with no file open
+        TuningFile();
+
+		// Open the file with the given name. Only the header of the file is
+		//   read, so opening takes the same time however large the file is.
+		//   Returns false if the header is not that of a file of the current
+		//   version whose sections fill the file (in which case no file is open).
+        bool open(const std::string& file);
+
+		// Returns true if the chords of the open file lie within its pitches and
+		//   every pitch refers to a valid ratio. The contents of a file are not
+		//   checked when it is opened, so this should be called before using a
+		//   file that may not have been written by saveTunings.
+        bool verify() const;
+
+		// Close the open file, invalidating every view into it
+        void close();
+
+		// Returns the number of chords in the open file
+        unsigned int size() const;
+
+		// Returns a view of the chords, e.g. to solve them again
+        ChordSequence getChords() const;
+
+		// Returns a view of the pitches of chord i and their frequencies, in the
+		//   order of the NoteTunings of its Tuning
+        FreqSpan operator[](unsigned int i) const;
+
+		// Returns the tuning ratio of pitch k of chord i
+        Frac getRatio(unsigned int i, unsigned int k) const;
+
+		// Returns the relative frequency the frequencies were calculated with
+		//   (see TuningSequence::getRelFreq)
+        double getRelFreq() const;
+
+		// Returns the TuningSequence stored in the file, rebuilt from its ratios
+        TuningSequence getTunings() const;
+};
+
+#endif
@@ -1,4 +1,5 @@
 #include <cmath>
+#include <array>
 #include <iostream>
 #include <list>
 #include <set>
@@ -84,12 +85,27 @@ Tuning Tuning::split(const std::list<EPitch>& filter) {
     return other;
 }
 
+Tuning Tuning::split(const PitchSpan& filter) {
+    Tuning other;
+    for (const EPitch& pitch : filter) {
+        auto it = std::find(noteTunings.begin(), noteTunings.end(), pitch);
+        other.addNoteTuning(*it);
+        noteTunings.erase(it);
+    }
+    return other;
+}
+
 std::vector<EPitchFreq> Tuning::getEPitchFreqs(double relFreq) const {
     std::vector<EPitchFreq> v;
+    getEPitchFreqs(relFreq, v);
+    return v;
+}
+
+void Tuning::getEPitchFreqs(double relFreq, std::vector<EPitchFreq>& freqs) const {
+    freqs.clear();
     for (const NoteTuning& nt : noteTunings) {
-        v.emplace_back(nt.getEPitchFreq(relFreq));
+        freqs.emplace_back(nt.getEPitchFreq(relFreq));
     }
-    return v;
 }
 
 Tuning Tuning::operator+(const NoteTuning& nt) const {
@@ -98,12 +114,32 @@ Tuning Tuning::operator+(const NoteTuning& nt) const {
     return newTuning;
 }
 
+Tuning Tuning::operator*(const Frac& f) const {
+    Tuning newTuning;
+    for (const NoteTuning& nt : noteTunings) {
+        newTuning.noteTunings.emplace_hint(newTuning.noteTunings.end(), NoteTuning{nt.pitch, nt.tuning * f});
+    }
+    return newTuning;
+}
+
+Tuning Tuning::operator/(const Frac& f) const {
+    Tuning newTuning;
+    for (const NoteTuning& nt : noteTunings) {
+        newTuning.noteTunings.emplace_hint(newTuning.noteTunings.end(), NoteTuning{nt.pitch, nt.tuning / f});
+    }
+    return newTuning;
+}
+
 TuningSequence Tuning::operator+(const TuningSequence& ts) const {
     TuningSequence newTuningSequence{ts};
     newTuningSequence.addTuningFront(*this);
     return newTuningSequence;
 }
 
+bool Tuning::operator==(const Tuning& other) const {
+    return noteTunings == other.noteTunings;
+}
+
 bool Tuning::operator<(const Tuning& other) const {
     return noteTunings < other.noteTunings;
 }
@@ -123,7 +159,7 @@ TuningSequence::TuningSequenceIter& TuningSequence::TuningSequenceIter::operator
     return *this;
 }
         
-Tuning TuningSequence::TuningSequenceIter::operator*() const {
+const Tuning& TuningSequence::TuningSequenceIter::operator*() const {
     return *it;
 }
 
@@ -145,17 +181,29 @@ TuningSequence& TuningSequence::addTuning(const Tuning& t) {
 
 std::vector<std::vector<EPitchFreq>> TuningSequence::getFreqs() const {
     std::vector<std::vector<EPitchFreq>> v;
-    if (tunings.empty()) return v;
-
-    NoteTuning nt = *(*tunings.begin()).begin();
-    double relFreq = getNormalFreq(nt.pitch) / nt.tuning;
-
+    double relFreq = getRelFreq();
     for (const Tuning& t : tunings) {
         v.emplace_back(t.getEPitchFreqs(relFreq));
     }
     return v;
 }
 
+void TuningSequence::getFreqs(std::vector<EPitchFreq>& freqs, std::vector<unsigned int>& offsets) const {
+    freqs.clear();
+    offsets.assign(1, 0);
+    double relFreq = getRelFreq();
+    for (const Tuning& t : tunings) {
+        for (const NoteTuning& nt : t) freqs.emplace_back(nt.getEPitchFreq(relFreq));
+        offsets.emplace_back(freqs.size());
+    }
+}
+
+double TuningSequence::getRelFreq() const {
+    if (tunings.empty()) return 0;
+    NoteTuning nt = *(*tunings.begin()).begin();
+    return getNormalFreq(nt.pitch) / nt.tuning;
+}
+
 bool TuningSequence::operator<(const TuningSequence& other) const {
     return tunings < other.tunings;
 }
@@ -171,6 +219,17 @@ TuningSequence::TuningSequenceIter TuningSequence::end() const {
 double getNormalFreq(const EPitch& pitch) {
     int offset = (static_cast<int>(pitch.pitch) - static_cast<int>(Pitch::A) + 12) % 12
                + 12 * (pitch.octave - 4 + (pitch.pitch < Pitch::A ? -1 : 0));
+
+	// The table holds the frequencies of every pitch from C in octave -1 (69
+	//   semitones below A-4) up to B in octave 9, computed the same way as
+	//   the frequencies outside of it
+    const int lowest = -69;
+    static const std::array<double, 132> table = []() {
+        std::array<double, 132> freqs;
+        for (int i = 0; i < 132; i++) freqs[i] = 440.0 * std::pow(2.0, (lowest + i) / 12.0);
+        return freqs;
+    }();
+    if (offset >= lowest && offset < lowest + 132) return table[offset - lowest];
     return 440.0 * std::pow(2.0, offset / 12.0);
 }
 
@@ -85,6 +85,7 @@ class Tuning {
 		// The filter list must only contain pitches that are in the current
 		//   Tuning, otherwise behaviour is undefined.
         Tuning split(const std::list<EPitch>& filter);
+        Tuning split(const PitchSpan& filter);
 
 		// Returns a vector of EPitchFreq objects containing the frequencies
 		//   (in Hz) to tune the pitches in every NoteTuning in the Tuning,
@@ -94,6 +95,11 @@ class Tuning {
 		//   getEPitchFreq using the same relFreq passed in, and appending
 		//   the resulting EPitchFreq to the end of an accumulating vector.
         std::vector<EPitchFreq> getEPitchFreqs(double relFreq) const;
+
+		// Same as above, but replaces the contents of the given vector with
+		//   the frequencies instead of allocating a new one, so that a caller
+		//   can reuse the same buffer for every Tuning
+        void getEPitchFreqs(double relFreq, std::vector<EPitchFreq>& freqs) const;
 		
 		class TuningIter {
 			// Iterator class for iterating over specific note tunings
@@ -129,6 +135,13 @@ class Tuning {
 		//   on the new object
         Tuning operator+(const NoteTuning&) const;
 		
+		// Return a new Tuning object with the ratio of every NoteTuning
+		//   multiplied (or divided) by the given Frac. Since only the ratios
+		//   between NoteTunings are meaningful, the new Tuning is equivalent
+		//   to the current one up to the choice of relative frequency.
+        Tuning operator*(const Frac&) const;
+        Tuning operator/(const Frac&) const;
+
 		// Return a new TuningSequence object containing every Tuning in
 		//   the right operand in addition to the Tuning that is the left
 		//   operand appended to the start of it
@@ -136,6 +149,10 @@ class Tuning {
 		//   addTuningFront on the new object
         TuningSequence operator+(const TuningSequence&) const;
 		
+		// Returns true if both Tuning objects contain the same NoteTuning
+		//   objects, and false otherwise
+        bool operator==(const Tuning&) const;
+
 		// Returns true if the Tuning on the left is less than the Tuning on
 		//   the right, and false otherwise. Between two Tuning objects, the one
 		//   with the smallest NoteTuning with respect to the < operator for
@@ -179,6 +196,17 @@ class TuningSequence {
 		//   Tuning in the TuningSequence, and dividing that by the tuning
 		//   ratio of the same NoteTuning.
         std::vector<std::vector<EPitchFreq>> getFreqs() const;
+
+		// Same as above, but replaces the contents of the given vectors with
+		//   the frequencies of every Tuning stored one after another: the
+		//   frequencies of Tuning i are freqs[offsets[i]] up to
+		//   freqs[offsets[i + 1]]. Allocates nothing when the vectors already
+		//   have enough capacity.
+        void getFreqs(std::vector<EPitchFreq>& freqs, std::vector<unsigned int>& offsets) const;
+
+		// Returns the relative frequency used by getFreqs (see above), or 0
+		//   if the TuningSequence is empty
+        double getRelFreq() const;
 		
 		class TuningSequenceIter {
 			// Iterator class for iterating over specific tunings in
@@ -190,7 +218,7 @@ class TuningSequence {
 				// Operators to support range-based for loops. See below for
 				//   documentation.
                 TuningSequence::TuningSequenceIter& operator++();
-                Tuning operator*() const;
+                const Tuning& operator*() const;
                 bool operator!=(const TuningSequence::TuningSequenceIter& other) const;
         
             friend TuningSequence;
@@ -215,7 +243,9 @@ class TuningSequence {
         bool operator<(const TuningSequence&) const;
 };
 
-// Returns the standard equal-temperament frequency of the given pitch object
+// Returns the standard equal-temperament frequency of the given pitch object.
+//   The frequencies of the pitches in octaves -1 to 9 are looked up in a
+//   table computed once.
 double getNormalFreq(const EPitch&);
 
 // Output operator for NoteTuning objects
@@ -0,0 +1,145 @@
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+
+#include "workers.h"
+
+// The Workers that started the calling thread, if any, and the queue of the
+//   calling thread in them
+thread_local const Workers* currentWorkers = nullptr;
+thread_local unsigned int currentQueue = 0;
+
+struct Workers::Group {
+    std::atomic<unsigned int> remaining;
+
+	// The group of the task that queued this group, if any
+    const Group* parent;
+
+	// Returns true if the given group is this group or was queued, directly
+	//   or not, by one of its tasks
+    bool contains(const Group* group) const {
+        for (; group; group = group->parent) {
+            if (group == this) return true;
+        }
+        return false;
+    }
+};
+
+thread_local const Workers::Group* Workers::currentGroup = nullptr;
+
+Workers::Workers(unsigned int count): queues{}, threads{}, sleepMutex{}, wake{}, queued{0}, pushes{0}, stopping{false} {
+    count = std::max(count, 1u);
+    for (unsigned int k = 0; k < count; k++) queues.emplace_back(std::make_unique<Queue>());
+    for (unsigned int k = 1; k < count; k++) threads.emplace_back(&Workers::loop, this, k);
+}
+
+Workers::~Workers() {
+    {
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& thread : threads) thread.join();
+}
+
+unsigned int Workers::size() const {
+    return queues.size();
+}
+
+void Workers::push(Task task) {
+    Queue& queue = *queues[currentWorkers == this ? currentQueue : 0];
+    queued++;
+    {
+        std::unique_lock<std::mutex> lock(queue.mutex);
+        queue.tasks.emplace_back(task);
+    }
+    std::unique_lock<std::mutex> lock(sleepMutex);
+    pushes++;
+    wake.notify_all();
+}
+
+bool Workers::take(Task& task, const Group* group) {
+    if (queued == 0) return false;
+    unsigned int own = currentWorkers == this ? currentQueue : 0;
+    {
+        Queue& queue = *queues[own];
+        std::unique_lock<std::mutex> lock(queue.mutex);
+        for (auto it = queue.tasks.rbegin(); it != queue.tasks.rend(); ++it) {
+            if (group && !group->contains(it->group)) continue;
+            task = *it;
+            queue.tasks.erase(std::next(it).base());
+            queued--;
+            return true;
+        }
+    }
+    for (unsigned int k = 1; k < queues.size(); k++) {
+        Queue& queue = *queues[(own + k) % queues.size()];
+        std::unique_lock<std::mutex> lock(queue.mutex);
+        for (auto it = queue.tasks.begin(); it != queue.tasks.end(); ++it) {
+            if (group && !group->contains(it->group)) continue;
+            task = *it;
+            queue.tasks.erase(it);
+            queued--;
+            return true;
+        }
+    }
+    return false;
+}
+
+void Workers::run(Task& task) {
+    const Group* outer = currentGroup;
+    currentGroup = task.group;
+    (*task.f)(task.i);
+    currentGroup = outer;
+
+	// The group belongs to a call to forEach that returns once it sees that no
+	//   tasks remain, so it must not be used after that
+    if (--task.group->remaining == 0) {
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wake.notify_all();
+    }
+}
+
+void Workers::loop(unsigned int queue) {
+    currentWorkers = this;
+    currentQueue = queue;
+    Task task;
+    while (true) {
+        if (take(task)) {
+            run(task);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wake.wait(lock, [&]() { return queued > 0 || stopping; });
+        if (stopping && queued == 0) return;
+    }
+}
+
+void Workers::forEach(unsigned int n, const std::function<void(unsigned int)>& f) {
+    if (n == 0) return;
+    Group group;
+    group.remaining = n;
+    group.parent = currentGroup;
+
+	// Tasks are queued last to first, so that the calling thread runs them
+	//   in order while other threads steal them from the end
+    for (unsigned int i = n; i-- > 0;) push(Task{&f, i, &group});
+    Task task;
+    while (group.remaining > 0) {
+		// Tasks queued after the search starts may have been missed, so the
+		//   thread only sleeps until the next one is queued
+        unsigned long seen = pushes;
+        if (take(task, &group)) {
+            run(task);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wake.wait(lock, [&]() { return group.remaining == 0 || pushes != seen; });
+    }
+}
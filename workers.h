@@ -0,0 +1,81 @@
+#ifndef _WORKERS_H_
+#define _WORKERS_H_
+
+#include <cstddef>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <thread>
+
+class Workers {
+	// Class that runs tasks on a fixed set of threads with work stealing. Every
+	//   thread has its own queue of tasks: it runs the tasks it queued itself
+	//   newest first, and when its queue is empty, it steals the oldest task
+	//   of another thread. Tasks may queue more tasks and wait for them, so
+	//   that a large task can be split up while it runs (e.g. a hierarchical
+	//   solve of a long Score, see Hierarchy). A thread that waits for tasks
+	//   only runs those tasks and the tasks they queue in turn, so that the
+	//   time a task takes only counts its own work, and tasks are only nested
+	//   as deep as they queue each other.
+    private:
+        struct Group;
+        struct Task {
+            const std::function<void(unsigned int)>* f;
+            unsigned int i;
+            Group* group;
+        };
+        struct Queue {
+            std::mutex mutex;
+            std::deque<Task> tasks;
+        };
+
+        std::vector<std::unique_ptr<Queue>> queues;
+        std::vector<std::thread> threads;
+        std::mutex sleepMutex;
+        std::condition_variable wake;
+        std::atomic<unsigned long> queued;
+        std::atomic<unsigned long> pushes;
+        bool stopping;
+
+		// The group of the task the calling thread is running, if any
+        static thread_local const Group* currentGroup;
+
+		// Queues a task on the queue of the calling thread. Threads that were
+		//   not started by the Workers share the first queue.
+        void push(Task);
+
+		// Takes a task from the queue of the calling thread, or steals one from
+		//   another queue. If a group is given, only takes the tasks of that
+		//   group and of the groups queued by its tasks. Returns false if there
+		//   is no such task.
+        bool take(Task&, const Group* = nullptr);
+
+		// Runs the given task and notes that it finished
+        void run(Task&);
+
+		// The loop of every thread: runs tasks until the Workers are destroyed
+        void loop(unsigned int);
+
+    public:
+		// Create a set of the given number of threads (at least 1). The thread
+		//   that calls forEach runs tasks as well, so one thread fewer is
+		//   started.
+        explicit Workers(unsigned int threads);
+
+		// Waits for the tasks that were queued and stops the threads
+        ~Workers();
+
+		// Returns the number of threads
+        unsigned int size() const;
+
+		// Runs f(0), ..., f(n - 1) as separate tasks and returns once they have
+		//   all finished. The calling thread runs these tasks (and the tasks
+		//   they queue) while it waits, so this may be called from a task.
+        void forEach(unsigned int n, const std::function<void(unsigned int)>& f);
+};
+
+#endif